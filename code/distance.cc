@@ -0,0 +1,613 @@
+//
+// distance.cc :  Implementation file for the distance kernels used by
+//                nearest neighbor queries over "pattern set" input vectors.
+//
+
+
+#include <cstring>
+
+#include "distance.h"
+
+// Vectorized kernels are only built for x86 processors with a compiler that
+// can target instruction sets beyond those enabled for the whole program ...
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISTANCE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+
+//
+// Scalar Kernels
+//
+
+static double squared_distance_scalar(const double* a, const double* b, int n) {
+    double sum0 = 0.0, sum1 = 0.0;
+    double diff0, diff1;
+    int j = 0;
+
+    // two independent sums let consecutive iterations overlap ...
+    for (; j + 1 < n; j += 2) {
+        diff0 = a[j] - b[j];
+        diff1 = a[j + 1] - b[j + 1];
+        sum0 += diff0 * diff0;
+        sum1 += diff1 * diff1;
+    }
+    if (j < n) {
+        diff0 = a[j] - b[j];
+        sum0 += diff0 * diff0;
+    }
+    return (sum0 + sum1);
+}
+
+static double dot_product_scalar(const double* a, const double* b, int n) {
+    double sum0 = 0.0, sum1 = 0.0;
+    int j = 0;
+
+    for (; j + 1 < n; j += 2) {
+        sum0 += a[j] * b[j];
+        sum1 += a[j + 1] * b[j + 1];
+    }
+    if (j < n)
+        sum0 += a[j] * b[j];
+    return (sum0 + sum1);
+}
+
+static double dot_and_norm_scalar(const double* a, const double* b, int n,
+        double* a_norm2) {
+    double dot = 0.0;
+    double norm2 = 0.0;
+
+    for (int j = 0; j < n; j++) {
+        dot += a[j] * b[j];
+        norm2 += a[j] * a[j];
+    }
+    *a_norm2 = norm2;
+    return (dot);
+}
+
+
+// The mixed precision kernels compare single-precision rows of a pattern set
+// against double-precision queries, widening each row element as it is
+// loaded so that all arithmetic is carried out in double precision ...
+
+static double squared_distance_mixed_scalar(const float* a, const double* b,
+        int n) {
+    double sum0 = 0.0, sum1 = 0.0;
+    double diff0, diff1;
+    int j = 0;
+
+    for (; j + 1 < n; j += 2) {
+        diff0 = (double) a[j] - b[j];
+        diff1 = (double) a[j + 1] - b[j + 1];
+        sum0 += diff0 * diff0;
+        sum1 += diff1 * diff1;
+    }
+    if (j < n) {
+        diff0 = (double) a[j] - b[j];
+        sum0 += diff0 * diff0;
+    }
+    return (sum0 + sum1);
+}
+
+static double dot_and_norm_mixed_scalar(const float* a, const double* b,
+        int n, double* a_norm2) {
+    double dot = 0.0;
+    double norm2 = 0.0;
+
+    for (int j = 0; j < n; j++) {
+        double a_j = a[j];
+        dot += a_j * b[j];
+        norm2 += a_j * a_j;
+    }
+    *a_norm2 = norm2;
+    return (dot);
+}
+
+
+// The quantized kernels compare rows of byte codes against double-precision
+// vectors expressed in the same units as the codes, so that no row needs to
+// be decoded before it is compared ...
+
+static double weighted_squared_distance_scalar(const unsigned char* codes,
+        const double* b, const double* weights, int n) {
+    double sum0 = 0.0, sum1 = 0.0;
+    double diff0, diff1;
+    int j = 0;
+
+    for (; j + 1 < n; j += 2) {
+        diff0 = codes[j] - b[j];
+        diff1 = codes[j + 1] - b[j + 1];
+        sum0 += weights[j] * diff0 * diff0;
+        sum1 += weights[j + 1] * diff1 * diff1;
+    }
+    if (j < n) {
+        diff0 = codes[j] - b[j];
+        sum0 += weights[j] * diff0 * diff0;
+    }
+    return (sum0 + sum1);
+}
+
+static double dot_product_codes_scalar(const unsigned char* codes,
+        const double* b, int n) {
+    double sum0 = 0.0, sum1 = 0.0;
+    int j = 0;
+
+    for (; j + 1 < n; j += 2) {
+        sum0 += codes[j] * b[j];
+        sum1 += codes[j + 1] * b[j + 1];
+    }
+    if (j < n)
+        sum0 += codes[j] * b[j];
+    return (sum0 + sum1);
+}
+
+
+#ifdef DISTANCE_KERNELS_X86
+
+//
+// AVX2 Kernels  --  Four doubles at a time, finishing the last few elements
+//                   with scalar arithmetic.
+//
+
+__attribute__((target("avx2,fma")))
+static double horizontal_sum_avx2(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    hi = _mm_unpackhi_pd(lo, lo);
+    return (_mm_cvtsd_f64(_mm_add_sd(lo, hi)));
+}
+
+__attribute__((target("avx2,fma")))
+static double squared_distance_avx2(const double* a, const double* b, int n) {
+    __m256d sum = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + j),
+                _mm256_loadu_pd(b + j));
+        sum = _mm256_fmadd_pd(diff, diff, sum);
+    }
+    double total = horizontal_sum_avx2(sum);
+    for (; j < n; j++) {
+        double diff = a[j] - b[j];
+        total += diff * diff;
+    }
+    return (total);
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_product_avx2(const double* a, const double* b, int n) {
+    __m256d sum = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4)
+        sum = _mm256_fmadd_pd(_mm256_loadu_pd(a + j), _mm256_loadu_pd(b + j), sum);
+    double total = horizontal_sum_avx2(sum);
+    for (; j < n; j++)
+        total += a[j] * b[j];
+    return (total);
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_and_norm_avx2(const double* a, const double* b, int n,
+        double* a_norm2) {
+    __m256d dot = _mm256_setzero_pd();
+    __m256d norm2 = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        __m256d a_v = _mm256_loadu_pd(a + j);
+        dot = _mm256_fmadd_pd(a_v, _mm256_loadu_pd(b + j), dot);
+        norm2 = _mm256_fmadd_pd(a_v, a_v, norm2);
+    }
+    double dot_total = horizontal_sum_avx2(dot);
+    double norm2_total = horizontal_sum_avx2(norm2);
+    for (; j < n; j++) {
+        dot_total += a[j] * b[j];
+        norm2_total += a[j] * a[j];
+    }
+    *a_norm2 = norm2_total;
+    return (dot_total);
+}
+
+__attribute__((target("avx2,fma")))
+static double squared_distance_mixed_avx2(const float* a, const double* b,
+        int n) {
+    __m256d sum = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        __m256d diff = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + j)),
+                _mm256_loadu_pd(b + j));
+        sum = _mm256_fmadd_pd(diff, diff, sum);
+    }
+    double total = horizontal_sum_avx2(sum);
+    for (; j < n; j++) {
+        double diff = (double) a[j] - b[j];
+        total += diff * diff;
+    }
+    return (total);
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_and_norm_mixed_avx2(const float* a, const double* b, int n,
+        double* a_norm2) {
+    __m256d dot = _mm256_setzero_pd();
+    __m256d norm2 = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        __m256d a_v = _mm256_cvtps_pd(_mm_loadu_ps(a + j));
+        dot = _mm256_fmadd_pd(a_v, _mm256_loadu_pd(b + j), dot);
+        norm2 = _mm256_fmadd_pd(a_v, a_v, norm2);
+    }
+    double dot_total = horizontal_sum_avx2(dot);
+    double norm2_total = horizontal_sum_avx2(norm2);
+    for (; j < n; j++) {
+        double a_j = a[j];
+        dot_total += a_j * b[j];
+        norm2_total += a_j * a_j;
+    }
+    *a_norm2 = norm2_total;
+    return (dot_total);
+}
+
+// load_codes_avx2 -- Load four byte codes widened to doubles.
+__attribute__((target("avx2,fma")))
+static inline __m256d load_codes_avx2(const unsigned char* codes) {
+    int packed;
+
+    memcpy(&packed, codes, sizeof(packed));
+    return (_mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed))));
+}
+
+__attribute__((target("avx2,fma")))
+static double weighted_squared_distance_avx2(const unsigned char* codes,
+        const double* b, const double* weights, int n) {
+    __m256d sum = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4) {
+        __m256d diff = _mm256_sub_pd(load_codes_avx2(codes + j),
+                _mm256_loadu_pd(b + j));
+        sum = _mm256_fmadd_pd(_mm256_mul_pd(diff, diff),
+                _mm256_loadu_pd(weights + j), sum);
+    }
+    double total = horizontal_sum_avx2(sum);
+    for (; j < n; j++) {
+        double diff = codes[j] - b[j];
+        total += weights[j] * diff * diff;
+    }
+    return (total);
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_product_codes_avx2(const unsigned char* codes,
+        const double* b, int n) {
+    __m256d sum = _mm256_setzero_pd();
+    int j = 0;
+
+    for (; j + 4 <= n; j += 4)
+        sum = _mm256_fmadd_pd(load_codes_avx2(codes + j),
+                _mm256_loadu_pd(b + j), sum);
+    double total = horizontal_sum_avx2(sum);
+    for (; j < n; j++)
+        total += codes[j] * b[j];
+    return (total);
+}
+
+
+//
+// AVX-512 Kernels  --  Eight doubles at a time, with a masked load for the
+//                      last few elements so that no scalar tail is needed.
+//
+
+__attribute__((target("avx512f")))
+static double horizontal_sum_avx512(__m512d v) {
+    double lanes[8];
+
+    _mm512_storeu_pd(lanes, v);
+    return (((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) +
+            ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7])));
+}
+
+__attribute__((target("avx512f")))
+static double squared_distance_avx512(const double* a, const double* b, int n) {
+    __m512d sum = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8) {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(a + j),
+                _mm512_loadu_pd(b + j));
+        sum = _mm512_fmadd_pd(diff, diff, sum);
+    }
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        __m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, a + j),
+                _mm512_maskz_loadu_pd(mask, b + j));
+        sum = _mm512_fmadd_pd(diff, diff, sum);
+    }
+    return (horizontal_sum_avx512(sum));
+}
+
+__attribute__((target("avx512f")))
+static double dot_product_avx512(const double* a, const double* b, int n) {
+    __m512d sum = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8)
+        sum = _mm512_fmadd_pd(_mm512_loadu_pd(a + j), _mm512_loadu_pd(b + j), sum);
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        sum = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + j),
+                _mm512_maskz_loadu_pd(mask, b + j), sum);
+    }
+    return (horizontal_sum_avx512(sum));
+}
+
+__attribute__((target("avx512f")))
+static double dot_and_norm_avx512(const double* a, const double* b, int n,
+        double* a_norm2) {
+    __m512d dot = _mm512_setzero_pd();
+    __m512d norm2 = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8) {
+        __m512d a_v = _mm512_loadu_pd(a + j);
+        dot = _mm512_fmadd_pd(a_v, _mm512_loadu_pd(b + j), dot);
+        norm2 = _mm512_fmadd_pd(a_v, a_v, norm2);
+    }
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        __m512d a_v = _mm512_maskz_loadu_pd(mask, a + j);
+        dot = _mm512_fmadd_pd(a_v, _mm512_maskz_loadu_pd(mask, b + j), dot);
+        norm2 = _mm512_fmadd_pd(a_v, a_v, norm2);
+    }
+    *a_norm2 = horizontal_sum_avx512(norm2);
+    return (horizontal_sum_avx512(dot));
+}
+
+// load_floats_avx512 -- Load eight floats widened to doubles, or only the
+//                       first "count" of them, the rest being zero.
+__attribute__((target("avx512f")))
+static inline __m512d load_floats_avx512(const float* a, int count) {
+    float tail[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    // The zero-masked conversion avoids reading an undefined vector ...
+    if (count >= 8)
+        return (_mm512_maskz_cvtps_pd((__mmask8) 0xff, _mm256_loadu_ps(a)));
+    for (int j = 0; j < count; j++)
+        tail[j] = a[j];
+    return (_mm512_maskz_cvtps_pd((__mmask8) 0xff, _mm256_loadu_ps(tail)));
+}
+
+__attribute__((target("avx512f")))
+static double squared_distance_mixed_avx512(const float* a, const double* b,
+        int n) {
+    __m512d sum = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8) {
+        __m512d diff = _mm512_sub_pd(load_floats_avx512(a + j, 8),
+                _mm512_loadu_pd(b + j));
+        sum = _mm512_fmadd_pd(diff, diff, sum);
+    }
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        __m512d diff = _mm512_sub_pd(load_floats_avx512(a + j, n - j),
+                _mm512_maskz_loadu_pd(mask, b + j));
+        sum = _mm512_fmadd_pd(diff, diff, sum);
+    }
+    return (horizontal_sum_avx512(sum));
+}
+
+__attribute__((target("avx512f")))
+static double dot_and_norm_mixed_avx512(const float* a, const double* b,
+        int n, double* a_norm2) {
+    __m512d dot = _mm512_setzero_pd();
+    __m512d norm2 = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8) {
+        __m512d a_v = load_floats_avx512(a + j, 8);
+        dot = _mm512_fmadd_pd(a_v, _mm512_loadu_pd(b + j), dot);
+        norm2 = _mm512_fmadd_pd(a_v, a_v, norm2);
+    }
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        __m512d a_v = load_floats_avx512(a + j, n - j);
+        dot = _mm512_fmadd_pd(a_v, _mm512_maskz_loadu_pd(mask, b + j), dot);
+        norm2 = _mm512_fmadd_pd(a_v, a_v, norm2);
+    }
+    *a_norm2 = horizontal_sum_avx512(norm2);
+    return (horizontal_sum_avx512(dot));
+}
+
+// load_codes_avx512 -- Load eight byte codes widened to doubles, or only the
+//                      first "count" of them, the rest being zero.
+__attribute__((target("avx512f")))
+static inline __m512d load_codes_avx512(const unsigned char* codes,
+        int count) {
+    unsigned char tail[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // "_mm_loadl_epi64" rather than "_mm_cvtsi64_si128", which only exists
+    // on 64 bit processors ...
+    if (count < 8) {
+        memcpy(tail, codes, count);
+        codes = tail;
+    }
+    return (_mm512_maskz_cvtepi32_pd((__mmask8) 0xff,
+                _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                        (const __m128i*) codes))));
+}
+
+__attribute__((target("avx512f")))
+static double weighted_squared_distance_avx512(const unsigned char* codes,
+        const double* b, const double* weights, int n) {
+    __m512d sum = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8) {
+        __m512d diff = _mm512_sub_pd(load_codes_avx512(codes + j, 8),
+                _mm512_loadu_pd(b + j));
+        sum = _mm512_fmadd_pd(_mm512_mul_pd(diff, diff),
+                _mm512_loadu_pd(weights + j), sum);
+    }
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        __m512d diff = _mm512_sub_pd(load_codes_avx512(codes + j, n - j),
+                _mm512_maskz_loadu_pd(mask, b + j));
+        sum = _mm512_fmadd_pd(_mm512_mul_pd(diff, diff),
+                _mm512_maskz_loadu_pd(mask, weights + j), sum);
+    }
+    return (horizontal_sum_avx512(sum));
+}
+
+__attribute__((target("avx512f")))
+static double dot_product_codes_avx512(const unsigned char* codes,
+        const double* b, int n) {
+    __m512d sum = _mm512_setzero_pd();
+    int j = 0;
+
+    for (; j + 8 <= n; j += 8)
+        sum = _mm512_fmadd_pd(load_codes_avx512(codes + j, 8),
+                _mm512_loadu_pd(b + j), sum);
+    if (j < n) {
+        __mmask8 mask = (__mmask8) ((1u << (n - j)) - 1);
+        sum = _mm512_fmadd_pd(load_codes_avx512(codes + j, n - j),
+                _mm512_maskz_loadu_pd(mask, b + j), sum);
+    }
+    return (horizontal_sum_avx512(sum));
+}
+
+#endif  // #ifdef DISTANCE_KERNELS_X86
+
+
+//
+// Kernel Selection
+//
+
+// DistanceKernels -- The set of kernels chosen for this processor.
+struct DistanceKernels {
+    const char* name;
+    double (*squared_distance)(const double*, const double*, int);
+    double (*dot_product)(const double*, const double*, int);
+    double (*dot_and_norm)(const double*, const double*, int, double*);
+    double (*squared_distance_mixed)(const float*, const double*, int);
+    double (*dot_and_norm_mixed)(const float*, const double*, int, double*);
+    double (*weighted_squared_distance)(const unsigned char*, const double*,
+            const double*, int);
+    double (*dot_product_codes)(const unsigned char*, const double*, int);
+};
+
+// select_kernels -- Return the widest set of kernels that this processor
+//                   supports.
+static DistanceKernels select_kernels() {
+    DistanceKernels k;
+
+    k.name = "scalar";
+    k.squared_distance = squared_distance_scalar;
+    k.dot_product = dot_product_scalar;
+    k.dot_and_norm = dot_and_norm_scalar;
+    k.squared_distance_mixed = squared_distance_mixed_scalar;
+    k.dot_and_norm_mixed = dot_and_norm_mixed_scalar;
+    k.weighted_squared_distance = weighted_squared_distance_scalar;
+    k.dot_product_codes = dot_product_codes_scalar;
+#ifdef DISTANCE_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        k.name = "avx512";
+        k.squared_distance = squared_distance_avx512;
+        k.dot_product = dot_product_avx512;
+        k.dot_and_norm = dot_and_norm_avx512;
+        k.squared_distance_mixed = squared_distance_mixed_avx512;
+        k.dot_and_norm_mixed = dot_and_norm_mixed_avx512;
+        k.weighted_squared_distance = weighted_squared_distance_avx512;
+        k.dot_product_codes = dot_product_codes_avx512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        k.name = "avx2";
+        k.squared_distance = squared_distance_avx2;
+        k.dot_product = dot_product_avx2;
+        k.dot_and_norm = dot_and_norm_avx2;
+        k.squared_distance_mixed = squared_distance_mixed_avx2;
+        k.dot_and_norm_mixed = dot_and_norm_mixed_avx2;
+        k.weighted_squared_distance = weighted_squared_distance_avx2;
+        k.dot_product_codes = dot_product_codes_avx2;
+    }
+#endif
+    return (k);
+}
+
+// The kernels are chosen once, before "main" runs, so that queries from
+// several threads never race to choose them ...
+static const DistanceKernels kernels = select_kernels();
+
+
+// squared_distance -- Return the squared Euclidean distance between the two
+//                     given vectors of length "n".
+
+double squared_distance(const double* a, const double* b, int n) {
+    return (kernels.squared_distance(a, b, n));
+}
+
+
+// dot_product -- Return the inner product of the two given vectors of
+//                length "n".
+
+double dot_product(const double* a, const double* b, int n) {
+    return (kernels.dot_product(a, b, n));
+}
+
+
+// dot_and_norm -- Return the inner product of the two given vectors of
+//                 length "n", storing the squared length of the first
+//                 vector in "a_norm2".
+
+double dot_and_norm(const double* a, const double* b, int n, double* a_norm2) {
+    return (kernels.dot_and_norm(a, b, n, a_norm2));
+}
+
+
+// squared_distance -- Return the squared Euclidean distance between the
+//                     given single-precision and double-precision vectors
+//                     of length "n", accumulated in double precision.
+
+double squared_distance(const float* a, const double* b, int n) {
+    return (kernels.squared_distance_mixed(a, b, n));
+}
+
+
+// dot_and_norm -- Return the inner product of the given single-precision
+//                 and double-precision vectors of length "n", storing the
+//                 squared length of the first vector in "a_norm2", both
+//                 accumulated in double precision.
+
+double dot_and_norm(const float* a, const double* b, int n, double* a_norm2) {
+    return (kernels.dot_and_norm_mixed(a, b, n, a_norm2));
+}
+
+
+// weighted_squared_distance -- Return the sum over all "n" elements of
+//                              "weights[j] * (codes[j] - b[j])^2".
+
+double weighted_squared_distance(const unsigned char* codes, const double* b,
+        const double* weights, int n) {
+    return (kernels.weighted_squared_distance(codes, b, weights, n));
+}
+
+
+// dot_product -- Return the inner product of the given vector of byte codes
+//                and double-precision vector, both of length "n".
+
+double dot_product(const unsigned char* codes, const double* b, int n) {
+    return (kernels.dot_product_codes(codes, b, n));
+}
+
+
+// distance_kernel_name -- Return the name of the instruction set used by the
+//                         kernels on this processor.
+
+const char* distance_kernel_name() {
+    return (kernels.name);
+}
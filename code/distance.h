@@ -0,0 +1,70 @@
+//
+// distance.h :  Specification file for the distance kernels used by nearest
+//               neighbor queries over "pattern set" input vectors.
+//
+// Each kernel works directly on contiguous arrays of doubles, such as the
+// rows of a pattern set's input matrix, so that no vector needs to be copied
+// before it is compared.  Vectorized versions of the kernels are chosen at
+// run time when the processor supports them, with portable scalar versions
+// used otherwise.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef DISTANCE_KERNELS_INCLUDED
+#define DISTANCE_KERNELS_INCLUDED 1
+
+
+// squared_distance -- Return the squared Euclidean distance between the two
+//                     given vectors of length "n".
+double squared_distance(const double* a, const double* b, int n);
+
+// dot_product -- Return the inner product of the two given vectors of
+//                length "n".
+double dot_product(const double* a, const double* b, int n);
+
+// dot_and_norm -- Return the inner product of the two given vectors of
+//                 length "n", storing the squared length of the first
+//                 vector in "a_norm2".  Both are computed in a single pass,
+//                 as needed for angular distances.
+double dot_and_norm(const double* a, const double* b, int n, double* a_norm2);
+
+// squared_distance -- Return the squared Euclidean distance between a
+//                     single-precision vector, such as a row of a compact
+//                     copy of the input vectors, and a double-precision
+//                     vector, both of length "n".  The elements of "a" are
+//                     widened as they are loaded and the sum is accumulated
+//                     in double precision.
+double squared_distance(const float* a, const double* b, int n);
+
+// dot_and_norm -- Return the inner product of a single-precision vector and
+//                 a double-precision vector of length "n", storing the
+//                 squared length of the first in "a_norm2", both accumulated
+//                 in double precision.
+double dot_and_norm(const float* a, const double* b, int n, double* a_norm2);
+
+
+// weighted_squared_distance -- Return the sum over all "n" elements of
+//                              "weights[j] * (codes[j] - b[j])^2", where
+//                              "codes" is a row of byte codes, as kept by a
+//                              quantized copy of the input vectors, and "b"
+//                              is a query expressed in the units of the
+//                              codes.  With each weight the square of its
+//                              column's scale, this is the squared Euclidean
+//                              distance between the decoded row and the
+//                              query, computed without decoding the row.
+double weighted_squared_distance(const unsigned char* codes, const double* b,
+        const double* weights, int n);
+
+// dot_product -- Return the inner product of a row of byte codes and a
+//                double-precision vector, both of length "n".
+double dot_product(const unsigned char* codes, const double* b, int n);
+
+
+// distance_kernel_name -- Return the name of the instruction set used by
+//                         the kernels on this processor, such as "avx2".
+const char* distance_kernel_name();
+
+
+
+#endif  // #ifndef DISTANCE_KERNELS_INCLUDED
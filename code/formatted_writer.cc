@@ -0,0 +1,153 @@
+//
+// formatted_writer.cc :  Implementation file for a buffered writer that
+//                        formats numbers for text output without going
+//                        through iostream formatting.
+//
+
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#include "formatted_writer.h"
+
+
+// largest number of digits after the decimal point handled without "printf"
+static const int max_fast_precision = 15;
+
+// Powers of ten that are exactly representable as doubles ...
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15
+};
+
+
+// format_fixed -- Format the given value into "text" with "precision" digits
+//                 after the decimal point, as "printf" would with "%.*f".
+//                 The value is scaled and rounded to an integer, which is
+//                 then printed digit by digit.  Scaling may be off by half a
+//                 unit in the last place, so values that fall too close to
+//                 a rounding boundary are left to "printf".
+
+int format_fixed(double value, int precision, char* text) {
+    if ((precision < 0) || (precision > max_fast_precision))
+        return (-1);
+    // this comparison also rejects infinities and NaNs ...
+    double scaled = fabs(value) * powers_of_ten[precision];
+    if (!(scaled < 4503599627370496.0))   // 2^52
+        return (-1);
+    double whole = floor(scaled);
+    double fraction = scaled - whole;     // exact below 2^52
+    if (fabs(fraction - 0.5) <= scaled * DBL_EPSILON)
+        return (-1);
+    unsigned long long digits = (unsigned long long) whole;
+    if (fraction > 0.5)
+        digits++;
+
+    // write the digits backwards from the end of a scratch area ...
+    char scratch[fixed_text_length];
+    char* p = scratch + fixed_text_length;
+    for (int i = 0; i < precision; i++) {
+        *--p = (char) ('0' + (digits % 10));
+        digits /= 10;
+    }
+    if (precision > 0)
+        *--p = '.';
+    do {
+        *--p = (char) ('0' + (digits % 10));
+        digits /= 10;
+    } while (digits > 0);
+    if (signbit(value))
+        *--p = '-';
+    int length = (int) (scratch + fixed_text_length - p);
+    memcpy(text, p, length);
+    return (length);
+}
+
+
+//
+// FormattedWriter Class  --  Member function implementations
+//
+
+FormattedWriter::FormattedWriter(ostream& out, size_t buffer_size) {
+    ostr = &out;
+    capacity = (buffer_size < 256) ? 256 : buffer_size;
+    buffer = new char[capacity];
+    used = 0;
+}
+
+FormattedWriter::~FormattedWriter() {
+    (void) flush();
+    delete [] buffer;
+}
+
+
+// put -- Append the given string to the output.
+
+void FormattedWriter::put(const char* text) {
+    put(text, strlen(text));
+}
+
+void FormattedWriter::put(const char* text, size_t length) {
+    if (length > capacity) {
+        // too long to buffer, so pass it straight through ...
+        (void) flush();
+        (void) ostr->write(text, length);
+        return;
+    }
+    reserve(length);
+    memcpy(buffer + used, text, length);
+    used += length;
+}
+
+
+// put_fixed -- Append the given value with "precision" digits after the
+//              decimal point, right justified in a field of "width"
+//              characters.
+
+void FormattedWriter::put_fixed(double value, int width, int precision) {
+    char text[fixed_text_length];
+    int length = format_fixed(value, precision, text);
+
+    if (length < 0) {
+        // fall back on "printf" for values the fast path cannot handle ...
+        char wide_text[512];
+        length = snprintf(wide_text, sizeof(wide_text), "%*.*f",
+                width, precision, value);
+        if (length >= (int) sizeof(wide_text))
+            length = sizeof(wide_text) - 1;
+        put(wide_text, length);
+        return;
+    }
+    for (; width > length; width--)
+        put(' ');
+    put(text, length);
+}
+
+
+// put_general -- Append the given value with "precision" significant
+//                digits.
+
+void FormattedWriter::put_general(double value, int precision) {
+    const int max_general_length = 64;
+
+    if (precision > 40)
+        precision = 40;
+    reserve(max_general_length);
+    used += snprintf(buffer + used, max_general_length, "%.*g",
+            precision, value);
+}
+
+
+// flush -- Hand all buffered text to the output stream.  Return false if
+//          the stream is in a failed state.
+
+bool FormattedWriter::flush() {
+    if (used > 0) {
+        (void) ostr->write(buffer, used);
+        used = 0;
+    }
+    return (ostr->good());
+}
@@ -0,0 +1,96 @@
+//
+// formatted_writer.h :  Specification file for a buffered writer that
+//                       formats numbers for text output without going
+//                       through iostream formatting.
+//
+// Values are formatted straight into a large buffer, which is handed to the
+// underlying stream a chunk at a time.  A chunk that is larger than the
+// stream's own buffer is written to its file with a single system call, and
+// no per-line flushing takes place, as it would with "endl".
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef FORMATTED_WRITER_INCLUDED
+#define FORMATTED_WRITER_INCLUDED 1
+
+
+#include <iostream>
+#include <cstddef>
+
+using namespace std;
+
+
+//
+// FormattedWriter Class  --  A buffer of formatted text on its way to an
+//                            output stream.  The buffer is flushed when it
+//                            fills, when "flush" is called, and when the
+//                            writer is destroyed.
+//
+
+class FormattedWriter {
+
+    private:
+
+        ostream* ostr;            // the stream receiving the text
+        char* buffer;             // text waiting to be written
+        size_t capacity;          // size of the buffer
+        size_t used;              // length of the text in the buffer
+
+        // reserve -- Make room for at least "n" more characters in the
+        //            buffer, flushing it if necessary.
+        inline void reserve(size_t n)
+            { if (used + n > capacity) (void) flush(); }
+
+        // Writers own their buffers, so they may not be copied ...
+        FormattedWriter(const FormattedWriter&);
+        FormattedWriter& operator=(const FormattedWriter&);
+
+    public:
+
+        // default size of the buffer, in characters
+        static const size_t default_capacity = 1 << 16;
+
+        FormattedWriter(ostream& out, size_t buffer_size = default_capacity);
+        ~FormattedWriter();
+
+        // put -- Append the given character or string to the output.
+        inline void put(char c)
+            { reserve(1); buffer[used++] = c; }
+        void put(const char* text);
+        void put(const char* text, size_t length);
+
+        // put_fixed -- Append the given value with "precision" digits after
+        //              the decimal point, right justified in a field of
+        //              "width" characters, exactly as "printf" would format
+        //              it with "%*.*f".
+        void put_fixed(double value, int width, int precision);
+
+        // put_general -- Append the given value with "precision" significant
+        //                digits, as an output stream would format it by
+        //                default ("printf" format "%.*g").
+        void put_general(double value, int precision = 6);
+
+        // flush -- Hand all buffered text to the output stream.  Return
+        //          false if the stream is in a failed state.
+        bool flush();
+
+        // good -- Return true if all text so far has been written without
+        //         error.
+        inline bool good() const { return (ostr->good()); }
+
+};
+
+
+// format_fixed -- Format the given value into "text" with "precision" digits
+//                 after the decimal point, as "printf" would with "%.*f",
+//                 without a terminating null.  Return the length of the
+//                 text, or a negative value if the value is beyond the
+//                 reach of the fast formatter, in which case "printf" should
+//                 be used instead.  The "text" array must hold at least
+//                 "fixed_text_length" characters.
+const int fixed_text_length = 40;
+int format_fixed(double value, int precision, char* text);
+
+
+#endif  // #ifndef FORMATTED_WRITER_INCLUDED
@@ -0,0 +1,644 @@
+//
+// hnsw_index.cc :  Implementation file for an approximate k-nearest neighbor
+//                  index over the input vectors of a "pattern set" object.
+//
+
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/stat.h>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_rng.h>
+
+#include "patterns.h"
+#include "hnsw_index.h"
+#include "distance.h"
+
+
+// HNSWFileHeader -- The layout of the start of a saved index.  The header
+//                   is followed by the top layer of every node, then the
+//                   bottom layer links of every node, then the upper layer
+//                   links of the nodes that have them, all as native ints.
+struct HNSWFileHeader {
+    char magic[8];            // "HNSWIDX" and a null
+    uint32_t byte_order;      // "hnsw_byte_order", as written
+    uint32_t version;         // "hnsw_file_version"
+    uint64_t n_points;        // number of indexed input vectors
+    uint32_t n_dims;          // number of values in each input vector
+    uint32_t metric;          // the "DistanceMetric" of the graph
+    uint32_t max_links;       // links per node on the upper layers
+    uint32_t max_base_links;  // links per node on the bottom layer
+    uint32_t ef_construction; // candidate list length while building
+    uint32_t ef_search;       // candidate list length while querying
+    int32_t entry_point;      // node on the top layer
+    int32_t top_level;        // highest layer of the graph
+};
+
+static const char hnsw_magic[8] = { 'H', 'N', 'S', 'W', 'I', 'D', 'X', '\0' };
+static const uint32_t hnsw_byte_order = 0x01020304;
+static const uint32_t hnsw_file_version = 1;
+
+// the largest link counts, top layer and candidate list lengths that a
+// saved index may hold; anything larger can only come from a corrupt file,
+// since each layer holds about one node in "max_links" of the layer below
+static const uint32_t hnsw_file_max_links = 1 << 16;
+static const int32_t hnsw_file_max_level = 64;
+static const uint32_t hnsw_file_max_ef = 1 << 24;
+
+
+// contiguous_query -- Return a pointer to the elements of the given vector
+//                     as a contiguous array, copying them into "buffer" only
+//                     if the vector is strided.
+static const double* contiguous_query(const gsl_vector* v,
+        vector<double>& buffer) {
+    if (v->stride == 1)
+        return (v->data);
+    buffer.resize(v->size);
+    for (size_t j = 0; j < v->size; j++)
+        buffer[j] = gsl_vector_get(v, j);
+    return (&buffer[0]);
+}
+
+
+//
+// HNSWIndex Class  --  Member function implementations
+//
+
+// constructors
+
+HNSWIndex::HNSWIndex() {
+    data_m = NULL;
+    n_points = 0;
+    n_dims = 0;
+    metric = EUCLIDEAN_METRIC;
+    max_links = default_max_links;
+    max_base_links = 2 * default_max_links;
+    ef_construction = default_ef_construction;
+    ef_search = default_ef_search;
+    entry_point = -1;
+    top_level = 0;
+    rand_generator = NULL;
+}
+
+HNSWIndex::HNSWIndex(const PatternSet& pset, DistanceMetric metric,
+        int links, int ef_build) {
+    data_m = NULL;
+    n_points = 0;
+    n_dims = 0;
+    this->metric = metric;
+    max_links = (links > 1) ? links : 2;
+    max_base_links = 2 * max_links;
+    ef_construction = (ef_build > max_links) ? ef_build : max_links;
+    ef_search = default_ef_search;
+    entry_point = -1;
+    top_level = 0;
+    // Use the random number algorithm and seed given by the GSL_RNG_TYPE
+    // and GSL_RNG_SEED environment variables, as "permute_patterns" does ...
+    (void) gsl_rng_env_setup();
+    rand_generator = gsl_rng_alloc(gsl_rng_default);
+    if ((rand_generator == NULL) || !attach(pset)) {
+        n_points = 0;
+        return;
+    }
+    levels.assign(n_points, 0);
+    base_links.assign((size_t) n_points * (max_base_links + 1), 0);
+    upper_links.resize(n_points);
+    for (int i = 0; i < n_points; i++)
+        insert(i, random_level());
+}
+
+
+// destructor
+
+HNSWIndex::~HNSWIndex() {
+    if (rand_generator)
+        gsl_rng_free(rand_generator);
+    rand_generator = NULL;
+    data_m = NULL;
+    n_points = 0;
+}
+
+
+// attach -- Refer to the input vectors of the given pattern set, computing
+//           their lengths if needed.  Return false if the pattern set has no
+//           input vectors.
+
+bool HNSWIndex::attach(const PatternSet& pset) {
+    data_m = pset.input_matrix();
+    if ((data_m == NULL) || (pset.number_of_patterns() <= 0)) {
+        data_m = NULL;
+        n_points = 0;
+        return (false);
+    }
+    n_points = pset.number_of_patterns();
+    n_dims = pset.number_of_inputs();
+    lengths.clear();
+    if (metric == ANGULAR_METRIC) {
+        lengths.resize(n_points);
+        for (int i = 0; i < n_points; i++)
+            lengths[i] = sqrt(dot_product(row(i), row(i), n_dims));
+    }
+    return (true);
+}
+
+
+// distance -- Return the distance used to build and search the graph
+//             between the "i"th input vector and the vector "q" of length
+//             "q_length".  Zero length vectors are taken as orthogonal to
+//             all others.
+
+double HNSWIndex::distance(int i, const double* q, double q_length) const {
+    if (metric == EUCLIDEAN_METRIC)
+        return (squared_distance(row(i), q, n_dims));
+    double scale = lengths[i] * q_length;
+    if (scale > 0)
+        return (1.0 - dot_product(row(i), q, n_dims) / scale);
+    return (1.0);
+}
+
+
+// greedy_descent -- Starting from the given neighbor, follow links to ever
+//                   closer nodes on each layer from "top_level" down to
+//                   "bottom_layer", returning the closest node found.
+
+Neighbor HNSWIndex::greedy_descent(Neighbor ep, const double* q,
+        double q_length, int bottom_layer) const {
+    for (int layer = top_level; layer >= bottom_layer; layer--) {
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            const int* links = link_list(ep.second, layer);
+            for (int t = 1; t <= links[0]; t++) {
+                Neighbor c(distance(links[t], q, q_length), links[t]);
+                if (c < ep) {
+                    ep = c;
+                    moved = true;
+                }
+            }
+        }
+    }
+    return (ep);
+}
+
+
+// search_layer -- Explore the given layer outward from the entry points,
+//                 keeping the "ef" closest nodes found in a bounded max-heap,
+//                 and stopping once the closest unexplored candidate is
+//                 farther than all of them.  Return the nodes found in order
+//                 of increasing distance.
+
+vector<Neighbor> HNSWIndex::search_layer(const double* q, double q_length,
+        const vector<Neighbor>& entry_points, int ef, int layer,
+        QueryWorkspace& ws) const {
+    priority_queue<Neighbor, vector<Neighbor>, greater<Neighbor> > candidates;
+    vector<Neighbor> found;
+
+    ws.begin_visits(n_points);
+    for (size_t e = 0; e < entry_points.size(); e++) {
+        (void) ws.visit(entry_points[e].second);
+        candidates.push(entry_points[e]);
+        offer_neighbor(found, ef, entry_points[e]);
+    }
+    while (!candidates.empty()) {
+        Neighbor c = candidates.top();
+        if (((int) found.size() >= ef) && (c.first > found.front().first))
+            break;
+        candidates.pop();
+        const int* links = link_list(c.second, layer);
+        for (int t = 1; t <= links[0]; t++) {
+            int node = links[t];
+            if (!ws.visit(node))
+                continue;
+            Neighbor n(distance(node, q, q_length), node);
+            if (((int) found.size() < ef) || (n < found.front())) {
+                candidates.push(n);
+                offer_neighbor(found, ef, n);
+            }
+        }
+    }
+    std::sort_heap(found.begin(), found.end());
+    return (found);
+}
+
+
+// select_neighbors -- Choose up to "m" of the given candidates, which are in
+//                     order of increasing distance, skipping any that lie
+//                     closer to an already chosen neighbor than to the node
+//                     being linked.
+
+void HNSWIndex::select_neighbors(const vector<Neighbor>& candidates, int m,
+        vector<Neighbor>& chosen) const {
+    chosen.clear();
+    for (size_t c = 0; (c < candidates.size()) && ((int) chosen.size() < m);
+            c++) {
+        int node = candidates[c].second;
+        const double* q = row(node);
+        double q_length = (metric == ANGULAR_METRIC) ? lengths[node] : 0.0;
+        bool diverse = true;
+        for (size_t s = 0; diverse && (s < chosen.size()); s++)
+            if (distance(chosen[s].second, q, q_length) < candidates[c].first)
+                diverse = false;
+        if (diverse)
+            chosen.push_back(candidates[c]);
+    }
+}
+
+
+// add_link -- Link node "from" to node "to" on the given layer, pruning the
+//             links of "from" if it has too many.
+
+void HNSWIndex::add_link(int from, int to, int layer) {
+    int* links = link_list(from, layer);
+    int capacity = (layer == 0) ? max_base_links : max_links;
+
+    if (links[0] < capacity) {
+        links[++links[0]] = to;
+        return;
+    }
+    // choose again among the old links and the new one ...
+    const double* q = row(from);
+    double q_length = (metric == ANGULAR_METRIC) ? lengths[from] : 0.0;
+    vector<Neighbor> candidates;
+    for (int t = 1; t <= links[0]; t++)
+        candidates.push_back(Neighbor(distance(links[t], q, q_length),
+                    links[t]));
+    candidates.push_back(Neighbor(distance(to, q, q_length), to));
+    std::sort(candidates.begin(), candidates.end());
+    vector<Neighbor> chosen;
+    select_neighbors(candidates, capacity, chosen);
+    links[0] = chosen.size();
+    for (size_t s = 0; s < chosen.size(); s++)
+        links[s + 1] = chosen[s].second;
+}
+
+
+// random_level -- Return a random top layer for a new node, each layer
+//                 holding about one node in "max_links" of the layer below.
+
+int HNSWIndex::random_level() {
+    double u = 1.0 - gsl_rng_uniform(rand_generator);
+    return ((int) floor(-log(u) / log((double) max_links)));
+}
+
+
+// insert -- Add the given node to the graph with the given top layer,
+//           linking it to its neighbors on every layer up to that one.
+
+void HNSWIndex::insert(int node, int level) {
+    levels[node] = level;
+    if (level > 0)
+        upper_links[node].assign((size_t) level * (max_links + 1), 0);
+    if (entry_point < 0) {
+        entry_point = node;
+        top_level = level;
+        return;
+    }
+    const double* q = row(node);
+    double q_length = (metric == ANGULAR_METRIC) ? lengths[node] : 0.0;
+    Neighbor ep(distance(entry_point, q, q_length), entry_point);
+    // descend quickly through the layers above the node's own ...
+    if (top_level > level)
+        ep = greedy_descent(ep, q, q_length, level + 1);
+    vector<Neighbor> entry_points(1, ep);
+    vector<Neighbor> chosen;
+    for (int layer = std::min(level, top_level); layer >= 0; layer--) {
+        vector<Neighbor> found = search_layer(q, q_length, entry_points,
+                ef_construction, layer, build_ws);
+        select_neighbors(found, max_links, chosen);
+        int* links = link_list(node, layer);
+        links[0] = chosen.size();
+        for (size_t s = 0; s < chosen.size(); s++) {
+            links[s + 1] = chosen[s].second;
+            add_link(chosen[s].second, node, layer);
+        }
+        entry_points.swap(found);
+    }
+    if (level > top_level) {
+        top_level = level;
+        entry_point = node;
+    }
+}
+
+
+// append_point -- Link the input vector that has just been appended to the
+//                 pattern set into the graph.  Return false on error.
+
+bool HNSWIndex::append_point() {
+    if ((data_m == NULL) || ((int) data_m->size1 != n_points + 1))
+        return (false);
+    int node = n_points++;
+    if (metric == ANGULAR_METRIC)
+        lengths.push_back(sqrt(dot_product(row(node), row(node), n_dims)));
+    levels.push_back(0);
+    base_links.resize((size_t) n_points * (max_base_links + 1), 0);
+    upper_links.push_back(vector<int>());
+    insert(node, random_level());
+    return (true);
+}
+
+
+// relink -- Choose new links for the given node on the given layer from its
+//           remaining links and the given candidates, after a neighbor has
+//           been erased.
+
+void HNSWIndex::relink(int node, int layer, const vector<int>& candidates) {
+    int* links = link_list(node, layer);
+    int capacity = (layer == 0) ? max_base_links : max_links;
+    const double* q = row(node);
+    double q_length = (metric == ANGULAR_METRIC) ? lengths[node] : 0.0;
+
+    vector<int> pool(links + 1, links + 1 + links[0]);
+    pool.insert(pool.end(), candidates.begin(), candidates.end());
+    std::sort(pool.begin(), pool.end());
+    pool.erase(std::unique(pool.begin(), pool.end()), pool.end());
+    vector<Neighbor> ranked;
+    for (size_t p = 0; p < pool.size(); p++)
+        if (pool[p] != node)
+            ranked.push_back(Neighbor(distance(pool[p], q, q_length),
+                        pool[p]));
+    std::sort(ranked.begin(), ranked.end());
+    vector<Neighbor> chosen;
+    select_neighbors(ranked, capacity, chosen);
+    links[0] = chosen.size();
+    for (size_t s = 0; s < chosen.size(); s++)
+        links[s + 1] = chosen[s].second;
+}
+
+
+// erase_point -- Follow "PatternSet::erase_pattern" in removing the "i"th
+//                pattern, the last pattern taking its place, and repair the
+//                links of the nodes that linked to it.  Return false on
+//                error.
+
+bool HNSWIndex::erase_point(int i) {
+    if ((data_m == NULL) || (i < 0) || (i >= n_points) ||
+            ((int) data_m->size1 != n_points - 1))
+        return (false);
+    int last = n_points - 1;
+
+    // keep the links of the erased node, as candidates for its neighbors ...
+    vector< vector<int> > orphans(levels[i] + 1);
+    for (int layer = 0; layer <= levels[i]; layer++) {
+        const int* links = link_list(i, layer);
+        orphans[layer].assign(links + 1, links + 1 + links[0]);
+    }
+    // unlink the erased node, noting which nodes lost a link ...
+    vector< pair<int, int> > damaged;
+    for (int node = 0; node < n_points; node++) {
+        if (node == i)
+            continue;
+        for (int layer = 0; layer <= levels[node]; layer++) {
+            int* links = link_list(node, layer);
+            for (int t = 1; t <= links[0]; t++)
+                if (links[t] == i) {
+                    links[t] = links[links[0]--];
+                    damaged.push_back(pair<int, int>(node, layer));
+                    break;
+                }
+        }
+    }
+    // move the last node into the erased node's place, renaming it ...
+    if (i != last) {
+        levels[i] = levels[last];
+        memcpy(link_list(i, 0), link_list(last, 0),
+                (max_base_links + 1) * sizeof(int));
+        upper_links[i].swap(upper_links[last]);
+        if (metric == ANGULAR_METRIC)
+            lengths[i] = lengths[last];
+        for (int node = 0; node < last; node++)
+            for (int layer = 0; layer <= levels[node]; layer++) {
+                int* links = link_list(node, layer);
+                for (int t = 1; t <= links[0]; t++)
+                    if (links[t] == last)
+                        links[t] = i;
+            }
+        for (size_t d = 0; d < damaged.size(); d++)
+            if (damaged[d].first == last)
+                damaged[d].first = i;
+        for (size_t layer = 0; layer < orphans.size(); layer++)
+            for (size_t t = 0; t < orphans[layer].size(); t++)
+                if (orphans[layer][t] == last)
+                    orphans[layer][t] = i;
+    }
+    bool entry_erased = (entry_point == i);
+    if (entry_point == last)
+        entry_point = i;
+    n_points--;
+    levels.pop_back();
+    base_links.resize((size_t) n_points * (max_base_links + 1));
+    upper_links.pop_back();
+    if (metric == ANGULAR_METRIC)
+        lengths.pop_back();
+    // a new entry point is needed if the old one was erased ...
+    if (entry_erased) {
+        entry_point = -1;
+        top_level = 0;
+        for (int node = 0; node < n_points; node++)
+            if ((entry_point < 0) || (levels[node] > top_level)) {
+                entry_point = node;
+                top_level = levels[node];
+            }
+    }
+    // let the nodes that lost a link choose again ...
+    for (size_t d = 0; d < damaged.size(); d++)
+        relink(damaged[d].first, damaged[d].second,
+                orphans[damaged[d].second]);
+    return (true);
+}
+
+
+// nearest -- Find (approximately) the "k" indexed input vectors closest to
+//            the given reference vector, writing their pattern indices to
+//            "nearest_i" and their distances to "nearest_d", closest first.
+//            Return the number of neighbors found, or a negative value on
+//            error.
+
+int HNSWIndex::nearest(gsl_vector* ref_v, int k, int* nearest_i,
+        double* nearest_d, QueryWorkspace& ws) const {
+    if ((k <= 0) || (nearest_i == NULL) || (nearest_d == NULL) ||
+            (ref_v == NULL) || (ref_v->size != n_dims) || (entry_point < 0))
+        return (-1);
+    vector<double> ref_buffer;
+    const double* q = contiguous_query(ref_v, ref_buffer);
+    double q_length = 0.0;
+    if (metric == ANGULAR_METRIC)
+        q_length = sqrt(dot_product(q, q, n_dims));
+
+    Neighbor ep(distance(entry_point, q, q_length), entry_point);
+    if (top_level > 0)
+        ep = greedy_descent(ep, q, q_length, 1);
+    vector<Neighbor> found = search_layer(q, q_length,
+            vector<Neighbor>(1, ep), std::max(ef_search, k), 0, ws);
+    if (k > (int) found.size())
+        k = found.size();
+    for (int t = 0; t < k; t++) {
+        int i = found[t].second;
+        nearest_i[t] = i;
+        if (metric == EUCLIDEAN_METRIC) {
+            nearest_d[t] = sqrt(found[t].first);
+        } else {
+            // report the similarity that "sort_angular" records ...
+            nearest_d[t] = (lengths[i] > 0) ?
+                (dot_product(row(i), q, n_dims) / lengths[i]) : 0.0;
+        }
+    }
+    return (k);
+}
+
+
+// save -- Write the graph to the named file.  Return false on error.
+
+bool HNSWIndex::save(const char* file_name) const {
+    HNSWFileHeader header;
+
+    if (entry_point < 0)
+        return (false);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, hnsw_magic, sizeof(header.magic));
+    header.byte_order = hnsw_byte_order;
+    header.version = hnsw_file_version;
+    header.n_points = n_points;
+    header.n_dims = n_dims;
+    header.metric = metric;
+    header.max_links = max_links;
+    header.max_base_links = max_base_links;
+    header.ef_construction = ef_construction;
+    header.ef_search = ef_search;
+    header.entry_point = entry_point;
+    header.top_level = top_level;
+
+    FILE* file = fopen(file_name, "wb");
+    if (file == NULL)
+        return (false);
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(&levels[0], sizeof(int), levels.size(), file) ==
+         levels.size()) &&
+        (fwrite(&base_links[0], sizeof(int), base_links.size(), file) ==
+         base_links.size());
+    for (int i = 0; ok && (i < n_points); i++)
+        if (!upper_links[i].empty())
+            ok = (fwrite(&upper_links[i][0], sizeof(int),
+                        upper_links[i].size(), file) == upper_links[i].size());
+    if (fclose(file) != 0)
+        ok = false;
+    return (ok);
+}
+
+
+// load -- Return a freshly allocated index read from the named file and
+//         attached to the input vectors of the given pattern set.  Return
+//         NULL on error.
+
+HNSWIndex* HNSWIndex::load(const char* file_name, const PatternSet& pset) {
+    HNSWFileHeader header;
+    struct stat file_stat;
+
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL)
+        return (NULL);
+    // the header must describe a graph of sane proportions over the given
+    // pattern set, before any of its counts size anything ...
+    if ((fstat(fileno(file), &file_stat) != 0) ||
+            (fread(&header, sizeof(header), 1, file) != 1) ||
+            (memcmp(header.magic, hnsw_magic, sizeof(header.magic)) != 0) ||
+            (header.byte_order != hnsw_byte_order) ||
+            (header.version != hnsw_file_version) ||
+            (pset.number_of_patterns() <= 0) ||
+            (header.n_points != (uint64_t) pset.number_of_patterns()) ||
+            (header.n_dims != (uint32_t) pset.number_of_inputs()) ||
+            (header.metric > ANGULAR_METRIC) || (header.max_links < 2) ||
+            (header.max_links > hnsw_file_max_links) ||
+            (header.max_base_links < header.max_links) ||
+            (header.max_base_links > hnsw_file_max_links) ||
+            (header.ef_construction < 1) ||
+            (header.ef_construction > hnsw_file_max_ef) ||
+            (header.ef_search < 1) || (header.ef_search > hnsw_file_max_ef) ||
+            (header.top_level < 0) ||
+            (header.top_level > hnsw_file_max_level) ||
+            (header.entry_point < 0) ||
+            (header.entry_point >= pset.number_of_patterns())) {
+        (void) fclose(file);
+        return (NULL);
+    }
+    // the file holds the top layer and the bottom layer links of every
+    // node, and then as many upper layer links as those top layers call
+    // for; none of these sizes can wrap, given the bounds above ...
+    uint64_t length = (uint64_t) file_stat.st_size;
+    uint64_t n = header.n_points;
+    uint64_t fixed_bytes = sizeof(header) +
+        n * (1 + (header.max_base_links + 1)) * sizeof(int);
+    if (length < fixed_bytes) {
+        (void) fclose(file);
+        return (NULL);
+    }
+    vector<int> levels(n);
+    bool ok = (fread(&levels[0], sizeof(int), n, file) == n);
+    uint64_t upper_bytes = 0;
+    for (uint64_t i = 0; ok && (i < n); i++) {
+        if ((levels[i] < 0) || (levels[i] > header.top_level))
+            ok = false;
+        else
+            upper_bytes += (uint64_t) levels[i] * (header.max_links + 1) *
+                sizeof(int);
+    }
+    if (!ok || (length != fixed_bytes + upper_bytes)) {
+        (void) fclose(file);
+        return (NULL);
+    }
+    HNSWIndex* index = new HNSWIndex();
+    index->metric = (DistanceMetric) header.metric;
+    index->max_links = (int) header.max_links;
+    index->max_base_links = (int) header.max_base_links;
+    index->ef_construction = (int) header.ef_construction;
+    index->ef_search = (int) header.ef_search;
+    index->entry_point = header.entry_point;
+    index->top_level = header.top_level;
+    (void) gsl_rng_env_setup();
+    index->rand_generator = gsl_rng_alloc(gsl_rng_default);
+    ok = index->attach(pset) && (index->n_points == (int) n);
+    if (ok) {
+        index->levels.swap(levels);
+        index->base_links.resize(n * (index->max_base_links + 1));
+        index->upper_links.resize(n);
+        ok = (fread(&index->base_links[0], sizeof(int),
+                    index->base_links.size(), file) ==
+                index->base_links.size());
+    }
+    for (int i = 0; ok && (i < (int) n); i++) {
+        int level = index->levels[i];
+        if (level > 0) {
+            vector<int>& links = index->upper_links[i];
+            links.resize((size_t) level * (index->max_links + 1));
+            ok = (fread(&links[0], sizeof(int), links.size(), file) ==
+                    links.size());
+        }
+    }
+    (void) fclose(file);
+    // make sure that every link leads to a node that exists ...
+    for (int i = 0; ok && (i < index->n_points); i++)
+        for (int layer = 0; ok && (layer <= index->levels[i]); layer++) {
+            const int* links = index->link_list(i, layer);
+            int capacity = (layer == 0) ? index->max_base_links :
+                index->max_links;
+            ok = (links[0] >= 0) && (links[0] <= capacity);
+            for (int t = 1; ok && (t <= links[0]); t++)
+                ok = (links[t] >= 0) && (links[t] < index->n_points) &&
+                    (index->levels[links[t]] >= layer);
+        }
+    if (ok && ((index->levels[index->entry_point] != index->top_level) ||
+                (index->rand_generator == NULL)))
+        ok = false;
+    if (!ok) {
+        delete index;
+        return (NULL);
+    }
+    return (index);
+}
@@ -0,0 +1,224 @@
+//
+// hnsw_index.h :  Specification file for an approximate k-nearest neighbor
+//                 index over the input vectors of a "pattern set" object.
+//
+// The index is a hierarchical navigable small world graph.  Every input
+// vector is a node, linked to a few of its near neighbors on the bottom
+// layer of the graph, and a random, geometrically shrinking subset of the
+// nodes is also linked on each of the layers above.  A query descends
+// greedily through the sparse upper layers and then explores the bottom
+// layer with a bounded list of candidates, visiting only a small fraction
+// of the nodes even when the input vectors have too many dimensions for a
+// tree index to prune well.  The length of the candidate list ("ef") trades
+// recall for speed.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef HNSW_INDEX_INCLUDED
+#define HNSW_INDEX_INCLUDED 1
+
+
+#include <vector>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_rng.h>
+
+#include "patterns.h"
+#include "knn_index.h"
+
+
+using namespace std;
+
+
+//
+// HNSWIndex Class  --  An approximate nearest neighbor index over the input
+//                      vectors of a pattern set, under either Euclidean or
+//                      angular distance.  Like a spatial index, it refers to
+//                      the input matrix of the pattern set rather than
+//                      copying it.  Patterns appended to or erased from
+//                      that pattern set must be passed on to the index
+//                      with "append_point" and "erase_point"; any other
+//                      change means that it must be rebuilt (or reloaded).
+//
+
+class HNSWIndex {
+
+    private:
+
+        const gsl_matrix* data_m; // the indexed input vectors, one per row
+        int n_points;             // number of indexed input vectors
+        int n_dims;               // number of values in each input vector
+        DistanceMetric metric;    // the distance the graph is built for
+
+        int max_links;            // links per node on the upper layers
+        int max_base_links;       // links per node on the bottom layer
+        int ef_construction;      // candidate list length while building
+        int ef_search;            // candidate list length while querying
+
+        int entry_point;          // node on the top layer, or -1 if empty
+        int top_level;            // highest layer of the graph
+        gsl_rng* rand_generator;  // source of the top layer of each node
+
+        vector<double> lengths;   // input vector lengths (angular only)
+        vector<int> levels;       // highest layer of each node
+        vector<int> base_links;   // bottom layer links of each node, stored
+                                  // as a count followed by "max_base_links"
+                                  // node numbers
+        vector< vector<int> > upper_links;  // upper layer links of each node,
+                                            // layer by layer, stored as a
+                                            // count followed by "max_links"
+                                            // node numbers
+        QueryWorkspace build_ws;  // visited marks while linking new nodes
+
+        HNSWIndex();
+
+        // indices are not copyable ...
+        HNSWIndex(const HNSWIndex&);
+        HNSWIndex& operator=(const HNSWIndex&);
+
+        // row -- Return a pointer to the "i"th indexed input vector.
+        inline const double* row(int i) const
+            { return (data_m->data + i * data_m->tda); }
+
+        // link_list -- Return the link list of the given node on the given
+        //              layer, its first element being the number of links.
+        inline int* link_list(int node, int layer)
+            { return (layer == 0 ? &base_links[node * (max_base_links + 1)] :
+                    &upper_links[node][(layer - 1) * (max_links + 1)]); }
+        inline const int* link_list(int node, int layer) const
+            { return (layer == 0 ? &base_links[node * (max_base_links + 1)] :
+                    &upper_links[node][(layer - 1) * (max_links + 1)]); }
+
+        // attach -- Refer to the input vectors of the given pattern set,
+        //           computing their lengths if needed.  Return false if the
+        //           pattern set has no input vectors.
+        bool attach(const PatternSet& pset);
+
+        // distance -- Return the distance used to build and search the graph
+        //             between the "i"th input vector and the vector "q" of
+        //             length "q_length": the squared Euclidean distance, or
+        //             one minus the cosine of the angle between them.
+        double distance(int i, const double* q, double q_length) const;
+
+        // greedy_descent -- Starting from the given neighbor, follow links
+        //                   to ever closer nodes on each layer from
+        //                   "top_level" down to "bottom_layer", returning the
+        //                   closest node found.
+        Neighbor greedy_descent(Neighbor ep, const double* q, double q_length,
+                int bottom_layer) const;
+
+        // search_layer -- Explore the given layer outward from the entry
+        //                 points, keeping the "ef" closest nodes found, and
+        //                 return them in order of increasing distance.  The
+        //                 visited nodes are marked in the given workspace.
+        vector<Neighbor> search_layer(const double* q, double q_length,
+                const vector<Neighbor>& entry_points, int ef, int layer,
+                QueryWorkspace& ws) const;
+
+        // select_neighbors -- Choose up to "m" of the given candidates, in
+        //                     order of increasing distance, skipping any that
+        //                     lie closer to an already chosen neighbor than to
+        //                     the node being linked, so that links spread out
+        //                     in different directions.
+        void select_neighbors(const vector<Neighbor>& candidates, int m,
+                vector<Neighbor>& chosen) const;
+
+        // add_link -- Link node "from" to node "to" on the given layer,
+        //             pruning the links of "from" if it has too many.
+        void add_link(int from, int to, int layer);
+
+        // random_level -- Return a random top layer for a new node, each
+        //                 layer holding about one node in "max_links" of
+        //                 the layer below.
+        int random_level();
+
+        // insert -- Add the given node to the graph with the given top layer.
+        void insert(int node, int level);
+
+        // relink -- Choose new links for the given node on the given layer
+        //           from its remaining links and the given candidates, after
+        //           a neighbor has been erased.
+        void relink(int node, int layer, const vector<int>& candidates);
+
+    public:
+
+        // default links per node on the upper layers
+        static const int default_max_links = 16;
+
+        // default candidate list length while building
+        static const int default_ef_construction = 200;
+
+        // default candidate list length while querying
+        static const int default_ef_search = 50;
+
+        // Build an index over the input vectors of the given pattern set
+        // for the given metric.  Each node keeps up to "links" links on the
+        // upper layers and twice as many on the bottom layer.  An index
+        // that could not be built holds no points.
+        HNSWIndex(const PatternSet& pset, DistanceMetric metric,
+                int links = default_max_links,
+                int ef_build = default_ef_construction);
+
+        ~HNSWIndex();
+
+        // number_of_points -- Return the number of indexed input vectors.
+        inline int number_of_points() const { return n_points; }
+
+        // distance_metric -- Return the metric that the index was built for.
+        inline DistanceMetric distance_metric() const { return metric; }
+
+        // set_ef_search -- Set the length of the candidate list used by
+        //                  queries.  Longer lists find the true nearest
+        //                  neighbors more often, but take longer.
+        inline void set_ef_search(int ef)
+            { ef_search = (ef > 0) ? ef : 1; }
+        inline int get_ef_search() const { return ef_search; }
+
+        // nearest -- Find (approximately) the "k" indexed input vectors
+        //            closest to the given reference vector, writing their
+        //            pattern indices to "nearest_i" and their distances to
+        //            "nearest_d", closest first.  Distances are reported as
+        //            by "PatternSet::nearest_euclidean" or
+        //            "PatternSet::nearest_angular".  The visited nodes are
+        //            marked in the given workspace, so several threads may
+        //            query the same index at once, each with a workspace of
+        //            its own, and a workspace used for many queries is never
+        //            cleared between them.  Return the number of neighbors
+        //            found, or a negative value on error.
+        int nearest(gsl_vector* ref_v, int k, int* nearest_i,
+                double* nearest_d, QueryWorkspace& ws) const;
+
+        // append_point -- Link the input vector that has just been appended
+        //                to the pattern set into the graph, as it would
+        //                have been linked had it been there from the start.
+        //                Return false if the pattern set does not have
+        //                exactly one more pattern than the index.
+        bool append_point();
+
+        // erase_point -- Follow "PatternSet::erase_pattern" in removing the
+        //                "i"th pattern, the last pattern taking its place.
+        //                Nodes that linked to the erased node choose new
+        //                links among their remaining neighbors and those of
+        //                the erased node.  This takes time in proportion to
+        //                the number of links in the graph.  Return false if
+        //                the pattern set does not have exactly one fewer
+        //                pattern than the index.
+        bool erase_point(int i);
+
+        // save -- Write the graph to the named file.  The input vectors are
+        //         not written.  Return false on error.
+        bool save(const char* file_name) const;
+
+        // load -- Return a freshly allocated index read from the named file
+        //         and attached to the input vectors of the given pattern
+        //         set, which must be the same vectors that the index was
+        //         built over.  Return NULL on error.
+        static HNSWIndex* load(const char* file_name, const PatternSet& pset);
+
+};
+
+
+
+#endif  // #ifndef HNSW_INDEX_INCLUDED
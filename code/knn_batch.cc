@@ -0,0 +1,363 @@
+//
+// knn_batch.cc :  Implementation file for k-nearest neighbor queries that
+//                 evaluate a whole "pattern set" of query vectors at once.
+//
+
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+#include <pthread.h>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_blas.h>
+
+#include "patterns.h"
+#include "knn_index.h"
+#include "knn_batch.h"
+#include "hnsw_index.h"
+#include "distance.h"
+
+
+// row_squared_norms -- Fill "norms" with the squared Euclidean length of
+//                      every row of the given matrix.
+static void row_squared_norms(const gsl_matrix* m, vector<double>& norms) {
+    norms.resize(m->size1);
+    for (size_t i = 0; i < m->size1; i++) {
+        gsl_vector_const_view row_v_view = gsl_matrix_const_row(m, i);
+        double length = gsl_blas_dnrm2(&row_v_view.vector);
+        norms[i] = length * length;
+    }
+}
+
+
+// run_workers -- Run "worker" on "job" on the calling thread and on
+//                "n_workers" - 1 others, returning once all of them have
+//                finished.  Workers that cannot be started are left out.
+static void run_workers(void* (*worker)(void*), void* job, int n_workers) {
+    // the calling thread is always one of the workers ...
+    if (n_workers < 1)
+        n_workers = 1;
+    vector<pthread_t> threads(n_workers - 1);
+    int n_started = 0;
+    for (int w = 0; w < n_workers - 1; w++) {
+        if (pthread_create(&threads[w], NULL, worker, job) != 0)
+            break;
+        n_started++;
+    }
+    (void) worker(job);
+    for (int w = 0; w < n_started; w++)
+        (void) pthread_join(threads[w], NULL);
+}
+
+
+// BatchQueryJob -- The state shared by the worker threads of a single
+//                  "batch_nearest" call.  Workers claim blocks of queries
+//                  by advancing "next_query" under "lock".
+struct BatchQueryJob {
+    const gsl_matrix* ref_m;
+    const gsl_matrix* query_m;
+    vector<double> ref_norms;
+    vector<double> query_norms;
+    int k;
+    int n_found;              // neighbors found for every query
+    int n_kept;               // candidates kept for every query
+    int* nearest_i;
+    double* nearest_d;
+
+    pthread_mutex_t lock;
+    int next_query;
+    bool failed;
+};
+
+
+// batch_query_worker -- Answer blocks of queries until none remain.  Each
+//                       worker has its own block of inner products and
+//                       heaps of candidates, so the shared matrices are
+//                       only ever read.
+static void* batch_query_worker(void* arg) {
+    BatchQueryJob* job = (BatchQueryJob*) arg;
+    const gsl_matrix* ref_m = job->ref_m;
+    const gsl_matrix* query_m = job->query_m;
+    int n_ref = (int) ref_m->size1;
+    int n_query = (int) query_m->size1;
+    int n_dims = (int) ref_m->size2;
+    int n_found = job->n_found;
+    int n_kept = job->n_kept;
+    int k = job->k;
+    // storage for one block of inner products, and for the bounded heap of
+    // best candidates for each query in a block ...
+    gsl_matrix* dots_m = gsl_matrix_alloc(batch_query_block,
+            batch_reference_block);
+    if (dots_m == NULL) {
+        (void) pthread_mutex_lock(&job->lock);
+        job->failed = true;
+        (void) pthread_mutex_unlock(&job->lock);
+        return (NULL);
+    }
+    vector< vector<Neighbor> > heaps(batch_query_block);
+    for (int q = 0; q < batch_query_block; q++)
+        heaps[q].reserve(n_kept);
+
+    for (;;) {
+        // claim the next block of queries ...
+        (void) pthread_mutex_lock(&job->lock);
+        int q0 = job->next_query;
+        job->next_query += batch_query_block;
+        (void) pthread_mutex_unlock(&job->lock);
+        if (q0 >= n_query)
+            break;
+        int q_n = std::min(batch_query_block, n_query - q0);
+        for (int q = 0; q < q_n; q++)
+            heaps[q].clear();
+        gsl_matrix_const_view query_block_view
+            = gsl_matrix_const_submatrix(query_m, q0, 0, q_n, n_dims);
+        for (int r0 = 0; r0 < n_ref; r0 += batch_reference_block) {
+            int r_n = std::min(batch_reference_block, n_ref - r0);
+            gsl_matrix_const_view ref_block_view
+                = gsl_matrix_const_submatrix(ref_m, r0, 0, r_n, n_dims);
+            gsl_matrix_view dots_block_view
+                = gsl_matrix_submatrix(dots_m, 0, 0, q_n, r_n);
+            // all of the inner products for this block in one product ...
+            (void) gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0,
+                    &query_block_view.matrix, &ref_block_view.matrix,
+                    0.0, &dots_block_view.matrix);
+            for (int q = 0; q < q_n; q++) {
+                const double* dots = gsl_matrix_const_ptr(dots_m, q, 0);
+                double q_norm = job->query_norms[q0 + q];
+                for (int r = 0; r < r_n; r++) {
+                    double d2 = q_norm + job->ref_norms[r0 + r] -
+                        2.0 * dots[r];
+                    // guard against rounding below zero ...
+                    if (d2 < 0.0)
+                        d2 = 0.0;
+                    offer_neighbor(heaps[q], n_kept, Neighbor(d2, r0 + r));
+                }
+            }
+        }
+        // the expanded form loses precision for nearby vectors, so the
+        // distances of the candidates are recomputed directly, and the
+        // nearest of them by those distances kept ...
+        for (int q = 0; q < q_n; q++) {
+            vector<Neighbor>& heap = heaps[q];
+            const double* q_row = gsl_matrix_const_ptr(query_m, q0 + q, 0);
+            for (int t = 0; t < (int) heap.size(); t++) {
+                heap[t].first = squared_distance(q_row,
+                        gsl_matrix_const_ptr(ref_m, heap[t].second, 0), n_dims);
+            }
+            std::sort(heap.begin(), heap.end());
+            int* row_i = job->nearest_i + (size_t) (q0 + q) * k;
+            double* row_d = job->nearest_d + (size_t) (q0 + q) * k;
+            for (int t = 0; t < n_found; t++) {
+                row_i[t] = heap[t].second;
+                row_d[t] = sqrt(heap[t].first);
+            }
+        }
+    }
+    gsl_matrix_free(dots_m);
+    return (NULL);
+}
+
+
+// batch_nearest -- For every input vector of the "queries" pattern set,
+//                  find the "k" input vectors of the "reference" pattern set
+//                  closest to it in Euclidean distance.  The neighbors of
+//                  query "q" are written to row "q" of the row-major
+//                  (number of queries) x "k" arrays "nearest_i", holding
+//                  pattern indices, and "nearest_d", holding distances, in
+//                  order of increasing distance.  Distances are computed a
+//                  block at a time as ||a||^2 + ||b||^2 - 2ab, with a single
+//                  matrix product per block, and the blocks of queries are
+//                  spread over "n_workers" threads.  That form loses
+//                  precision for nearby vectors, so a few more candidates
+//                  than "k" are kept and ranked again by their exact
+//                  distances.  Return the number of neighbors found for
+//                  each query, or a negative value on error.
+
+int batch_nearest(const PatternSet& reference, const PatternSet& queries,
+        int k, int* nearest_i, double* nearest_d, int n_workers) {
+    const gsl_matrix* ref_m = reference.input_matrix();
+    const gsl_matrix* query_m = queries.input_matrix();
+
+    if ((ref_m == NULL) || (query_m == NULL) ||
+            (ref_m->size2 != query_m->size2) || (k <= 0) ||
+            (nearest_i == NULL) || (nearest_d == NULL))
+        return (-1);
+    BatchQueryJob job;
+    job.ref_m = ref_m;
+    job.query_m = query_m;
+    job.k = k;
+    job.n_found = std::min(k, (int) ref_m->size1);
+    job.n_kept = std::min(k + batch_extra_candidates, (int) ref_m->size1);
+    job.nearest_i = nearest_i;
+    job.nearest_d = nearest_d;
+    // the squared lengths of the reference vectors are shared by every
+    // block of queries ...
+    row_squared_norms(ref_m, job.ref_norms);
+    row_squared_norms(query_m, job.query_norms);
+    job.next_query = 0;
+    job.failed = false;
+    (void) pthread_mutex_init(&job.lock, NULL);
+    run_workers(batch_query_worker, &job, n_workers);
+    (void) pthread_mutex_destroy(&job.lock);
+    if (job.failed)
+        return (-1);
+    return (job.n_found);
+}
+
+
+// ParallelQueryJob -- The state shared by the worker threads of a single
+//                     "parallel_nearest" or "parallel_graph_nearest"
+//                     call.  Workers claim chunks of queries by advancing
+//                     "next_query" under "lock".
+struct ParallelQueryJob {
+    const PatternSet* reference;
+    const SpatialIndex* index;
+    const HNSWIndex* graph;
+    const PatternSet* queries;
+    int k;
+    int n_found;              // neighbors that every query must find
+    DistanceMetric metric;
+    int* nearest_i;
+    double* nearest_d;
+
+    pthread_mutex_t lock;
+    int next_query;
+    bool failed;
+};
+
+
+// parallel_query_worker -- Answer chunks of queries until none remain.  Each
+//                          worker has its own query vector and workspace,
+//                          so the shared pattern sets are only ever read.
+static void* parallel_query_worker(void* arg) {
+    ParallelQueryJob* job = (ParallelQueryJob*) arg;
+    int n_query = job->queries->number_of_patterns();
+    int k = job->k;
+    bool failed = false;
+    QueryWorkspace ws(job->reference ?
+            job->reference->number_of_patterns() : 0);
+    gsl_vector* query_v = gsl_vector_alloc(job->queries->number_of_inputs());
+
+    if (query_v == NULL)
+        failed = true;
+    while (!failed) {
+        // claim the next chunk of queries ...
+        (void) pthread_mutex_lock(&job->lock);
+        int begin = job->next_query;
+        job->next_query += parallel_query_chunk;
+        (void) pthread_mutex_unlock(&job->lock);
+        if (begin >= n_query)
+            break;
+        int end = std::min(begin + parallel_query_chunk, n_query);
+        for (int q = begin; (q < end) && !failed; q++) {
+            int* row_i = job->nearest_i + q * k;
+            double* row_d = job->nearest_d + q * k;
+            int found;
+            (void) job->queries->input_pattern(q, query_v);
+            if (job->graph)
+                found = job->graph->nearest(query_v, k, row_i, row_d, ws);
+            else if (job->metric == ANGULAR_METRIC)
+                found = job->reference->nearest_angular(query_v, k,
+                        row_i, row_d, ws);
+            else if (job->index)
+                found = job->index->nearest(query_v, k, row_i, row_d);
+            else
+                found = job->reference->nearest_euclidean(query_v, k,
+                        row_i, row_d, ws);
+            if (found < job->n_found)
+                failed = true;
+        }
+    }
+    if (query_v)
+        gsl_vector_free(query_v);
+    if (failed) {
+        (void) pthread_mutex_lock(&job->lock);
+        job->failed = true;
+        (void) pthread_mutex_unlock(&job->lock);
+    }
+    return (NULL);
+}
+
+
+// run_parallel_queries -- Answer the queries of the given job on the
+//                         calling thread and "n_workers" - 1 others.
+//                         Return false if any query failed.
+static bool run_parallel_queries(ParallelQueryJob& job, int n_workers) {
+    job.next_query = 0;
+    job.failed = false;
+    (void) pthread_mutex_init(&job.lock, NULL);
+    run_workers(parallel_query_worker, &job, n_workers);
+    (void) pthread_mutex_destroy(&job.lock);
+    return (!job.failed);
+}
+
+
+// parallel_nearest -- For every input vector of the "queries" pattern set,
+//                     find the "k" input vectors of the "reference" pattern
+//                     set closest to it under the given distance metric,
+//                     spreading the queries over "n_workers" threads.
+//                     Euclidean queries are answered by "index" when it is
+//                     not NULL, and by a scan of the reference set otherwise.
+//                     Results are written to "nearest_i" and "nearest_d" as
+//                     by "batch_nearest", with angular neighbors reported as
+//                     by "PatternSet::nearest_angular".  Return the number of
+//                     neighbors found for each query, or a negative value on
+//                     error.
+
+int parallel_nearest(const PatternSet& reference, const SpatialIndex* index,
+        const PatternSet& queries, int k, DistanceMetric metric,
+        int n_workers, int* nearest_i, double* nearest_d) {
+    if ((reference.number_of_patterns() <= 0) ||
+            (queries.number_of_patterns() < 0) ||
+            (reference.number_of_inputs() != queries.number_of_inputs()) ||
+            (k <= 0) || (nearest_i == NULL) || (nearest_d == NULL))
+        return (-1);
+    ParallelQueryJob job;
+    job.reference = &reference;
+    job.index = index;
+    job.graph = NULL;
+    job.queries = &queries;
+    job.k = k;
+    job.n_found = std::min(k, reference.number_of_patterns());
+    job.metric = metric;
+    job.nearest_i = nearest_i;
+    job.nearest_d = nearest_d;
+    if (!run_parallel_queries(job, n_workers))
+        return (-1);
+    return (job.n_found);
+}
+
+
+// parallel_graph_nearest -- For every input vector of the "queries"
+//                           pattern set, find (approximately) the "k"
+//                           input vectors indexed by "graph" closest to it,
+//                           spreading the queries over "n_workers" threads,
+//                           each with a workspace of its own.  Results are
+//                           written as by "parallel_nearest".  Return the
+//                           number of neighbors found for each query, or a
+//                           negative value on error, including a query for
+//                           which the graph search finds too few neighbors.
+
+int parallel_graph_nearest(const HNSWIndex& graph, const PatternSet& queries,
+        int k, int n_workers, int* nearest_i, double* nearest_d) {
+    if ((graph.number_of_points() <= 0) ||
+            (queries.number_of_patterns() < 0) ||
+            (k <= 0) || (nearest_i == NULL) || (nearest_d == NULL))
+        return (-1);
+    ParallelQueryJob job;
+    job.reference = NULL;
+    job.index = NULL;
+    job.graph = &graph;
+    job.queries = &queries;
+    job.k = k;
+    job.n_found = std::min(k, graph.number_of_points());
+    job.metric = graph.distance_metric();
+    job.nearest_i = nearest_i;
+    job.nearest_d = nearest_d;
+    if (!run_parallel_queries(job, n_workers))
+        return (-1);
+    return (job.n_found);
+}
@@ -0,0 +1,82 @@
+//
+// knn_batch.h :  Specification file for k-nearest neighbor queries that
+//                evaluate a whole "pattern set" of query vectors at once.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef KNN_BATCH_INCLUDED
+#define KNN_BATCH_INCLUDED 1
+
+
+#include "patterns.h"
+#include "knn_index.h"
+
+
+// Forward declarations ...
+class HNSWIndex;
+
+
+// number of query vectors in each block of the distance matrix
+const int batch_query_block = 128;
+
+// number of reference vectors in each block of the distance matrix
+const int batch_reference_block = 512;
+
+// number of candidates kept for each query beyond the "k" asked for, whose
+// distances are recomputed exactly before the nearest "k" are chosen
+const int batch_extra_candidates = 8;
+
+// number of query vectors a worker thread takes at a time
+const int parallel_query_chunk = 16;
+
+
+// batch_nearest -- For every input vector of the "queries" pattern set,
+//                  find the "k" input vectors of the "reference" pattern set
+//                  closest to it in Euclidean distance.  The neighbors of
+//                  query "q" are written to row "q" of the row-major
+//                  (number of queries) x "k" arrays "nearest_i", holding
+//                  pattern indices, and "nearest_d", holding distances, in
+//                  order of increasing distance.  Distances are computed a
+//                  block at a time as ||a||^2 + ||b||^2 - 2ab, with a single
+//                  matrix product per block, and the blocks of queries are
+//                  spread over "n_workers" threads.  That form loses
+//                  precision for nearby vectors, so a few more candidates
+//                  than "k" are kept and ranked again by their exact
+//                  distances.  Return the number of neighbors found for
+//                  each query, or a negative value on error.
+int batch_nearest(const PatternSet& reference, const PatternSet& queries,
+        int k, int* nearest_i, double* nearest_d, int n_workers = 1);
+
+
+// parallel_nearest -- For every input vector of the "queries" pattern set,
+//                     find the "k" input vectors of the "reference" pattern
+//                     set closest to it under the given distance metric,
+//                     spreading the queries over "n_workers" threads.
+//                     Euclidean queries are answered by "index" when it is
+//                     not NULL, and by a scan of the reference set otherwise.
+//                     Results are written to "nearest_i" and "nearest_d" as
+//                     by "batch_nearest", with angular neighbors reported as
+//                     by "PatternSet::nearest_angular".  Return the number of
+//                     neighbors found for each query, or a negative value on
+//                     error.
+int parallel_nearest(const PatternSet& reference, const SpatialIndex* index,
+        const PatternSet& queries, int k, DistanceMetric metric,
+        int n_workers, int* nearest_i, double* nearest_d);
+
+
+// parallel_graph_nearest -- For every input vector of the "queries" pattern
+//                           set, find (approximately) the "k" input vectors
+//                           indexed by "graph" closest to it, under the
+//                           metric the graph was built for, spreading the
+//                           queries over "n_workers" threads.  Results are
+//                           written as by "parallel_nearest", with
+//                           distances reported as by "HNSWIndex::nearest".
+//                           Return the number of neighbors found for each
+//                           query, or a negative value on error, including
+//                           a query for which fewer were found.
+int parallel_graph_nearest(const HNSWIndex& graph, const PatternSet& queries,
+        int k, int n_workers, int* nearest_i, double* nearest_d);
+
+
+#endif  // #ifndef KNN_BATCH_INCLUDED
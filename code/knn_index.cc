@@ -0,0 +1,374 @@
+//
+// knn_index.cc :  Implementation file for spatial indices that answer exact
+//                 k-nearest neighbor queries over the input vectors of a
+//                 "pattern set" object.
+//
+
+
+#include <algorithm>
+#include <cmath>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+#include "patterns.h"
+#include "knn_index.h"
+#include "distance.h"
+
+
+//
+// Utility Functions
+//
+
+// CoordinateOrder -- A comparison object that orders pattern indices by the
+//                    value of a single input dimension.
+struct CoordinateOrder {
+    const gsl_matrix* data_m;
+    int dim;
+
+    CoordinateOrder(const gsl_matrix* m, int d) : data_m(m), dim(d) {}
+
+    bool operator()(int a, int b) const {
+        return (data_m->data[a * data_m->tda + dim] <
+                data_m->data[b * data_m->tda + dim]);
+    }
+};
+
+
+// offer_neighbor -- Add a candidate to the bounded max-heap of the "k" best
+//                   candidates, if it beats the worst of them.
+
+void offer_neighbor(vector<Neighbor>& heap, int k, Neighbor c) {
+    if ((int) heap.size() < k) {
+        heap.push_back(c);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (c < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = c;
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+
+//
+// SpatialIndex Class  --  Member function implementations
+//
+
+// constructor
+
+SpatialIndex::SpatialIndex(const gsl_matrix* inputs_m) {
+    data_m = inputs_m;
+    if (data_m) {
+        n_points = (int) data_m->size1;
+        n_dims = (int) data_m->size2;
+    } else {
+        n_points = 0;
+        n_dims = 0;
+    }
+    n_erased = 0;
+}
+
+
+// destructor
+
+SpatialIndex::~SpatialIndex() {
+    data_m = NULL;
+    n_points = 0;
+    n_dims = 0;
+}
+
+
+// build_tree -- Build the tree over every indexed input vector, discarding
+//               any previous tree, erased places and pending vectors.
+
+void SpatialIndex::build_tree() {
+    index.resize(n_points);
+    for (int i = 0; i < n_points; i++)
+        index[i] = i;
+    nodes.clear();
+    pending.clear();
+    n_erased = 0;
+    if (n_points > 0)
+        (void) build_node(0, n_points);
+    // "build_node" rearranges the patterns, so note where each one ended up ...
+    position.resize(n_points);
+    for (int t = 0; t < n_points; t++)
+        position[index[t]] = t;
+}
+
+
+// build_node -- Recursively split the given range of the "index" array at
+//               the median of its widest dimension, returning the number of
+//               the new node.
+
+int SpatialIndex::build_node(int begin, int end) {
+    int node_i = (int) nodes.size();
+    Node node;
+
+    node.begin = begin;
+    node.end = end;
+    node.left = -1;
+    node.right = -1;
+    node.split_dim = 0;
+    node.split_value = 0.0;
+    node.radius = 0.0;
+    nodes.push_back(node);
+    if ((end - begin) > leaf_size) {
+        // find the dimension with the widest spread of values ...
+        double best_spread = -1.0;
+        for (int j = 0; j < n_dims; j++) {
+            double lo = row(index[begin])[j];
+            double hi = lo;
+            for (int t = begin + 1; t < end; t++) {
+                double value = row(index[t])[j];
+                if (value < lo)
+                    lo = value;
+                if (value > hi)
+                    hi = value;
+            }
+            if ((hi - lo) > best_spread) {
+                best_spread = hi - lo;
+                nodes[node_i].split_dim = j;
+            }
+        }
+        // partition about the median of that dimension ...
+        int mid = begin + (end - begin) / 2;
+        int dim = nodes[node_i].split_dim;
+        std::nth_element(&index[0] + begin, &index[0] + mid, &index[0] + end,
+                CoordinateOrder(data_m, dim));
+        nodes[node_i].split_value = row(index[mid])[dim];
+        // build the children, noting that "nodes" may be reallocated ...
+        int left = build_node(begin, mid);
+        int right = build_node(mid, end);
+        nodes[node_i].left = left;
+        nodes[node_i].right = right;
+    }
+    return (node_i);
+}
+
+
+// scan_leaf -- Offer every pattern in the given leaf node to the bounded
+//              heap of the "k" best candidates.
+
+void SpatialIndex::scan_leaf(const Node& node, const double* q,
+        vector<Neighbor>& heap, int k) const {
+    for (int t = node.begin; t < node.end; t++) {
+        int i = index[t];
+        if (i < 0)
+            continue;
+        offer_neighbor(heap, k,
+                Neighbor(squared_distance(row(i), q, n_dims), i));
+    }
+}
+
+
+// nearest -- Find the "k" indexed input vectors closest, in Euclidean
+//            distance, to the given reference vector, writing their pattern
+//            indices to "nearest_i" and their distances to "nearest_d", in
+//            order of increasing distance.  Return the number of neighbors
+//            found, or a negative value on error.
+
+int SpatialIndex::nearest(gsl_vector* ref_v, int k, int* nearest_i,
+        double* nearest_d) const {
+    if ((n_points <= 0) || (ref_v == NULL) || (ref_v->size != n_dims) ||
+            (k <= 0) || (nearest_i == NULL) || (nearest_d == NULL))
+        return (-1);
+    if (k > n_points)
+        k = n_points;
+    // gather the reference vector into contiguous storage ...
+    vector<double> q(n_dims);
+    for (int j = 0; j < n_dims; j++)
+        q[j] = gsl_vector_get(ref_v, j);
+    vector<Neighbor> heap;
+    heap.reserve(k);
+    if (!nodes.empty())
+        search(0, &q[0], heap, k);
+    // vectors appended since the tree was built are checked one by one ...
+    for (size_t p = 0; p < pending.size(); p++)
+        offer_neighbor(heap, k, Neighbor(squared_distance(row(pending[p]),
+                        &q[0], n_dims), pending[p]));
+    // the heap holds the "k" best candidates, worst first ...
+    std::sort_heap(heap.begin(), heap.end());
+    for (int t = 0; t < (int) heap.size(); t++) {
+        nearest_i[t] = heap[t].second;
+        nearest_d[t] = sqrt(heap[t].first);
+    }
+    return ((int) heap.size());
+}
+
+
+// append_point -- Index the input vector that has just been appended to the
+//                 pattern set, rebuilding the tree once the vectors appended
+//                 and erased since the last build amount to a quarter of
+//                 the total.  Return false on error.
+
+bool SpatialIndex::append_point() {
+    if ((data_m == NULL) || ((int) data_m->size1 != n_points + 1))
+        return (false);
+    position.push_back(-1);
+    pending.push_back(n_points);
+    n_points++;
+    if (4 * (int) (pending.size() + n_erased) > n_points)
+        build_tree();
+    return (true);
+}
+
+
+// erase_point -- Follow "PatternSet::erase_pattern" in removing the "i"th
+//                pattern, the last pattern taking its place.  Return false
+//                on error.
+
+bool SpatialIndex::erase_point(int i) {
+    if ((data_m == NULL) || (i < 0) || (i >= n_points) ||
+            ((int) data_m->size1 != n_points - 1))
+        return (false);
+    int last = n_points - 1;
+    // forget the erased pattern ...
+    if (position[i] >= 0) {
+        index[position[i]] = -1;
+        n_erased++;
+    } else {
+        pending.erase(std::find(pending.begin(), pending.end(), i));
+    }
+    // the moved pattern keeps its place, under its new index ...
+    if (i != last) {
+        position[i] = position[last];
+        if (position[i] >= 0)
+            index[position[i]] = i;
+        else
+            *std::find(pending.begin(), pending.end(), last) = i;
+    }
+    position.pop_back();
+    n_points--;
+    if (4 * (int) (pending.size() + n_erased) > n_points)
+        build_tree();
+    return (true);
+}
+
+
+// build -- Return a freshly allocated index over the input vectors of the
+//          given pattern set, choosing a k-d tree for low dimensional inputs
+//          and a ball tree otherwise.  Return NULL on error.
+
+SpatialIndex* SpatialIndex::build(const PatternSet& pset) {
+    const gsl_matrix* inputs_m = pset.input_matrix();
+
+    if ((pset.number_of_patterns() <= 0) || (inputs_m == NULL))
+        return (NULL);
+    if (pset.number_of_inputs() <= max_kd_tree_dims)
+        return (new KDTree(inputs_m));
+    else
+        return (new BallTree(inputs_m));
+}
+
+
+//
+// KDTree Class  --  Member function implementations
+//
+
+// constructor
+
+KDTree::KDTree(const gsl_matrix* inputs_m) : SpatialIndex(inputs_m) {
+    build_tree();
+}
+
+
+// search -- Descend into the child on the query's side of the splitting
+//           plane first, visiting the other child only if the plane is no
+//           farther away than the worst of the "k" best candidates.
+
+void KDTree::search(int node_i, const double* q,
+        vector<Neighbor>& heap, int k) const {
+    const Node& node = nodes[node_i];
+
+    if (node.left < 0) {
+        scan_leaf(node, q, heap, k);
+        return;
+    }
+    double diff = q[node.split_dim] - node.split_value;
+    int near_i = (diff < 0.0) ? node.left : node.right;
+    int far_i = (diff < 0.0) ? node.right : node.left;
+    search(near_i, q, heap, k);
+    if (((int) heap.size() < k) || (diff * diff <= heap.front().first))
+        search(far_i, q, heap, k);
+}
+
+
+//
+// BallTree Class  --  Member function implementations
+//
+
+// constructor
+
+BallTree::BallTree(const gsl_matrix* inputs_m) : SpatialIndex(inputs_m) {
+    build_tree();
+}
+
+
+// build_tree -- Build the tree, then bound every node with a ball about the
+//               centroid of its patterns.
+
+void BallTree::build_tree() {
+    SpatialIndex::build_tree();
+    centers.assign(nodes.size() * n_dims, 0.0);
+    for (int node_i = 0; node_i < (int) nodes.size(); node_i++) {
+        Node& node = nodes[node_i];
+        double* c = &centers[0] + node_i * n_dims;
+        for (int t = node.begin; t < node.end; t++)
+            for (int j = 0; j < n_dims; j++)
+                c[j] += row(index[t])[j];
+        for (int j = 0; j < n_dims; j++)
+            c[j] /= (node.end - node.begin);
+        double max_d2 = 0.0;
+        for (int t = node.begin; t < node.end; t++) {
+            double d2 = squared_distance(row(index[t]), c, n_dims);
+            if (d2 > max_d2)
+                max_d2 = d2;
+        }
+        node.radius = sqrt(max_d2);
+    }
+}
+
+
+// center_distance -- Return the Euclidean distance from the query vector
+//                    to the ball center of the given node.
+
+double BallTree::center_distance(int node_i, const double* q) const {
+    return (sqrt(squared_distance(center(node_i), q, n_dims)));
+}
+
+
+// search -- Descend into the child whose center is closest to the query
+//           first, visiting a child only if its ball could contain a
+//           pattern closer than the worst of the "k" best candidates.
+
+void BallTree::search(int node_i, const double* q,
+        vector<Neighbor>& heap, int k) const {
+    const Node& node = nodes[node_i];
+
+    if (node.left < 0) {
+        scan_leaf(node, q, heap, k);
+        return;
+    }
+    double left_d = center_distance(node.left, q);
+    double right_d = center_distance(node.right, q);
+    int child_i[2];
+    double bound[2];
+    if (left_d <= right_d) {
+        child_i[0] = node.left;
+        bound[0] = left_d - nodes[node.left].radius;
+        child_i[1] = node.right;
+        bound[1] = right_d - nodes[node.right].radius;
+    } else {
+        child_i[0] = node.right;
+        bound[0] = right_d - nodes[node.right].radius;
+        child_i[1] = node.left;
+        bound[1] = left_d - nodes[node.left].radius;
+    }
+    for (int c = 0; c < 2; c++) {
+        // no pattern in the child's ball is closer than "bound" ...
+        if (((int) heap.size() < k) || (bound[c] <= 0.0) ||
+                (bound[c] * bound[c] <= heap.front().first))
+            search(child_i[c], q, heap, k);
+    }
+}
@@ -0,0 +1,210 @@
+//
+// knn_index.h :  Specification file for spatial indices that answer exact
+//                k-nearest neighbor queries over the input vectors of a
+//                "pattern set" object.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef KNN_INDEX_INCLUDED
+#define KNN_INDEX_INCLUDED 1
+
+
+#include <vector>
+#include <utility>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+#include "patterns.h"
+
+
+using namespace std;
+
+
+// Neighbor -- A squared Euclidean distance paired with the index of the
+//             pattern at that distance.  Neighbors compare by distance and
+//             then by index, so a max-heap of them keeps the worst of the
+//             best candidates found so far on top.
+typedef pair<double, int> Neighbor;
+
+// offer_neighbor -- Add a candidate to the bounded max-heap of the "k" best
+//                   candidates, if it beats the worst of them.
+void offer_neighbor(vector<Neighbor>& heap, int k, Neighbor c);
+
+
+//
+// SpatialIndex Class  --  A search structure built once over the input
+//                         vectors of a pattern set, answering Euclidean
+//                         k-nearest neighbor queries without scanning every
+//                         pattern.  The index refers to the input matrix of
+//                         the pattern set rather than copying it.  Patterns
+//                         appended to or erased from that pattern set must
+//                         be passed on to the index with "append_point" and
+//                         "erase_point"; any other change means that it must
+//                         be rebuilt.
+//
+
+class SpatialIndex {
+
+    protected:
+
+        // Node -- One node of the tree, covering a contiguous range of the
+        //         "index" array.  Leaves have no children.
+        struct Node {
+            int begin;            // first position in "index" covered
+            int end;              // one past the last position covered
+            int left;             // left child node, or -1 for a leaf
+            int right;            // right child node, or -1 for a leaf
+            int split_dim;        // input dimension used to split this node
+            double split_value;   // value of that dimension at the split
+            double radius;        // bounding ball radius (ball trees only)
+        };
+
+        const gsl_matrix* data_m; // the indexed input vectors, one per row
+        int n_points;             // number of indexed input vectors
+        int n_dims;               // number of values in each input vector
+
+        vector<int> index;        // pattern indices, grouped by node, with
+                                  // -1 marking an erased pattern
+        vector<Node> nodes;       // tree nodes, the root being node zero
+
+        vector<int> position;     // place of each pattern in "index", or -1
+                                  // for patterns appended since the build
+        vector<int> pending;      // patterns appended since the build
+        int n_erased;             // erased places left in "index"
+
+        SpatialIndex(const gsl_matrix* inputs_m);
+
+        // row -- Return a pointer to the "i"th indexed input vector.
+        inline const double* row(int i) const
+            { return (data_m->data + i * data_m->tda); }
+
+        // build_tree -- Build the tree over every indexed input vector,
+        //               discarding any previous tree.
+        virtual void build_tree();
+
+        // build_node -- Recursively split the given range of the "index"
+        //               array at the median of its widest dimension,
+        //               returning the number of the new node.
+        int build_node(int begin, int end);
+
+        // scan_leaf -- Offer every pattern in the given leaf node to the
+        //              bounded heap of the "k" best candidates.
+        void scan_leaf(const Node& node, const double* q,
+                vector<Neighbor>& heap, int k) const;
+
+        // search -- Descend from the given node, updating the heap of the "k"
+        //           best candidates for the query vector "q".
+        virtual void search(int node_i, const double* q,
+                vector<Neighbor>& heap, int k) const = 0;
+
+    private:
+
+        // indices are not copyable ...
+        SpatialIndex(const SpatialIndex&);
+        SpatialIndex& operator=(const SpatialIndex&);
+
+    public:
+
+        // maximum number of patterns stored in a leaf node
+        static const int leaf_size = 16;
+
+        // widest input vectors for which "build" chooses a k-d tree
+        static const int max_kd_tree_dims = 16;
+
+        virtual ~SpatialIndex();
+
+        // number_of_points -- Return the number of indexed input vectors.
+        inline int number_of_points() const { return n_points; }
+
+        // append_point -- Index the input vector that has just been appended
+        //                to the pattern set.  New vectors are scanned by
+        //                every query until the tree is rebuilt, which
+        //                happens once the vectors appended and erased since
+        //                the last build amount to a quarter of the total, so
+        //                that rebuilding takes logarithmic time per change on
+        //                average.  Return false if the pattern set does not
+        //                have exactly one more pattern than the index.
+        bool append_point();
+
+        // erase_point -- Follow "PatternSet::erase_pattern" in removing the
+        //               "i"th pattern, the last pattern taking its place.
+        //               Return false if the pattern set does not have
+        //               exactly one fewer pattern than the index.
+        bool erase_point(int i);
+
+        // nearest -- Find the "k" indexed input vectors closest, in Euclidean
+        //            distance, to the given reference vector, writing their
+        //            pattern indices to "nearest_i" and their distances to
+        //            "nearest_d", in order of increasing distance.  Return the
+        //            number of neighbors found, or a negative value on error.
+        int nearest(gsl_vector* ref_v, int k, int* nearest_i,
+                double* nearest_d) const;
+
+        // build -- Return a freshly allocated index over the input vectors of
+        //          the given pattern set, choosing a k-d tree for low
+        //          dimensional inputs and a ball tree otherwise.  Return NULL
+        //          on error.
+        static SpatialIndex* build(const PatternSet& pset);
+
+};
+
+
+//
+// KDTree Class  --  A spatial index that prunes subtrees by their distance
+//                   from axis-aligned splitting planes.  Best suited to
+//                   input vectors with few dimensions.
+//
+
+class KDTree : public SpatialIndex {
+
+    protected:
+
+        void search(int node_i, const double* q,
+                vector<Neighbor>& heap, int k) const;
+
+    public:
+
+        KDTree(const gsl_matrix* inputs_m);
+
+};
+
+
+//
+// BallTree Class  --  A spatial index that prunes subtrees by their distance
+//                     from bounding hyperspheres, which remain effective on
+//                     input vectors with more dimensions than a k-d tree can
+//                     handle well.
+//
+
+class BallTree : public SpatialIndex {
+
+    private:
+
+        vector<double> centers;   // ball center for each node, row by row
+
+        // center -- Return a pointer to the ball center of the given node.
+        inline const double* center(int node_i) const
+            { return (&centers[0] + node_i * n_dims); }
+
+        // center_distance -- Return the Euclidean distance from the query
+        //                    vector to the ball center of the given node.
+        double center_distance(int node_i, const double* q) const;
+
+    protected:
+
+        void build_tree();
+
+        void search(int node_i, const double* q,
+                vector<Neighbor>& heap, int k) const;
+
+    public:
+
+        BallTree(const gsl_matrix* inputs_m);
+
+};
+
+
+
+#endif  // #ifndef KNN_INDEX_INCLUDED
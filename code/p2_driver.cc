@@ -17,6 +17,12 @@
 #include <gsl/gsl_vector.h>
 
 #include "patterns.h"
+#include "knn_index.h"
+#include "knn_batch.h"
+#include "hnsw_index.h"
+#include "pca_model.h"
+#include "pattern_io.h"
+#include "formatted_writer.h"
 
 
 using namespace std;
@@ -46,7 +52,6 @@ int main(int argc, char** argv) {
     int number_of_patterns;
     PatternSet* pset;
     string pattern_file_name;
-    ifstream input_file_str;
     ifstream config_file_str;
 
     // Check number of arguments ...
@@ -70,42 +75,109 @@ int main(int argc, char** argv) {
     config_file_str >> num_testing;
     config_file_str >> testing_file;
     config_file_str >> output_file;
+    //an optional last entry gives the number of worker threads to use
+    int num_workers;
+    if(!(config_file_str >> num_workers) || num_workers < 1)
+        num_workers = 1;
+    //and an optional entry after that asks for approximate neighbors from a
+    //navigable graph, giving the length of its candidate list per query
+    int approximate_ef;
+    if(!(config_file_str >> approximate_ef) || approximate_ef < 0)
+        approximate_ef = 0;
+    //and an optional entry after that asks for neighbors to be found among
+    //the leading principal components of the training inputs
+    int pca_components;
+    if(!(config_file_str >> pca_components) || pca_components < 0)
+        pca_components = 0;
 
-    cout << k << " " << input_dimensionality << " " << output_dimensionality << " " << distance_metric << " " << output_method << " " << num_training << " " << training_file << " " << num_testing << " " << testing_file << " " << output_file << endl;
-    // Make pattern set ...
-    pset = new PatternSet(num_training, input_dimensionality, output_dimensionality);
-    // Open the pattern set file ...
-    input_file_str.open(trim(training_file).c_str());
-    if (!input_file_str.is_open()) {
-        cerr << argv[0] << " error:  cannot open specified pattern file." << endl;
+    cout << k << " " << input_dimensionality << " " << output_dimensionality << " " << distance_metric << " " << output_method << " " << num_training << " " << training_file << " " << num_testing << " " << testing_file << " " << output_file << " " << num_workers << " " << approximate_ef << " " << pca_components << endl;
+    // Make pattern sets, discovering their sizes from the files when the
+    // config leaves the number of patterns or inputs unspecified ...
+    bool unsized = (num_training <= 0 || num_testing <= 0 || input_dimensionality <= 0);
+    int num_inputs = (input_dimensionality > 0) ? input_dimensionality : -1;
+    PatternSet* testingSet;
+    if (unsized) {
+        pset = new PatternSet();
+        testingSet = new PatternSet();
+    } else {
+        pset = new PatternSet(num_training, input_dimensionality, output_dimensionality);
+        testingSet = new PatternSet(num_testing, input_dimensionality, output_dimensionality);
+    }
+    // Read the patterns, mapping the pattern set file into memory ...
+    if (unsized ? !read_unsized_pattern_file(trim(training_file).c_str(), *pset, num_inputs, output_dimensionality)
+                : !read_pattern_file(trim(training_file).c_str(), *pset, num_workers)) {
+        cerr << argv[0] << " error:  cannot read specified pattern file." << endl;
         return (-1);
     }
-    // Read the patterns ...
-    input_file_str >> (*pset);
-    // Close the pattern set file ...
-    if (input_file_str.is_open())
-        input_file_str.close();
     /* cout << (*pset); */ 
 
     //clasify the training set... and I wonder
-    PatternSet* testingSet = new PatternSet(num_testing, input_dimensionality, output_dimensionality);
-    input_file_str.open(trim(testing_file).c_str());
-    if(!input_file_str.is_open()) {
-        cerr << argv[0] << " error: cannot open specified pattern file." << endl;
+    if (unsized ? !read_unsized_pattern_file(trim(testing_file).c_str(), *testingSet, pset->number_of_inputs(), output_dimensionality)
+                : !read_pattern_file(trim(testing_file).c_str(), *testingSet, num_workers)) {
+        cerr << argv[0] << " error: cannot read specified pattern file." << endl;
         return (-1);
     }
-    //read the patterns
-    input_file_str >> (*testingSet);
-    //close the pattern set file
-    if(input_file_str.is_open())
-        input_file_str.close();
+    if (unsized) {
+        num_training = pset->number_of_patterns();
+        num_testing = testingSet->number_of_patterns();
+        input_dimensionality = pset->number_of_inputs();
+        cout << "discovered " << num_training << " training and " << num_testing << " testing patterns of " << input_dimensionality << " inputs" << endl;
+    }
 
     gsl_vector* input_vector = gsl_vector_alloc(input_dimensionality);
     gsl_vector* output = gsl_vector_alloc(output_dimensionality);
     gsl_vector* target_vector = gsl_vector_alloc(output_dimensionality);
     gsl_vector* neighbor_i = gsl_vector_alloc(output_dimensionality);
     pset->set_permute_flag();
+    //the k nearest neighbors of each test pattern, and their distances, one
+    //row of k entries per test pattern
+    int* nearest_i = new int[num_testing * k];
+    double* nearest_d = new double[num_testing * k];
+    //neighbors are searched for among the training inputs, or among their
+    //projections onto principal components fitted to the training set, with
+    //the test inputs projected the same way
+    PatternSet* searchSet = pset;
+    PatternSet* querySet = testingSet;
+    PCAModel* pca = NULL;
+    if(pca_components > 0) {
+        pca = new PCAModel(*pset, pca_components, 1.0, num_workers);
+        if(pca->number_of_components() <= 0) {
+            cerr << argv[0] << " error: could not fit the principal components." << endl;
+            return (-1);
+        }
+        searchSet = new PatternSet(pset->pca_projection(*pca));
+        querySet = new PatternSet(testingSet->pca_projection(*pca));
+    }
+    int search_dimensionality = searchSet->number_of_inputs();
+    //neighbors for the whole test set are found up front, spread across the
+    //worker threads. euclidean neighbors come from a blocked distance matrix
+    //when the inputs are too wide for a k-d tree, and otherwise every query
+    //is answered on its own
+    SpatialIndex* index = NULL;
+    HNSWIndex* graph = NULL;
+    int found = -1;
+    if(approximate_ef > 0 && (distance_metric[0] == 'E' || distance_metric[0] == 'A')) {
+        graph = new HNSWIndex(*searchSet, (distance_metric[0] == 'E') ? EUCLIDEAN_METRIC : ANGULAR_METRIC);
+        graph->set_ef_search(approximate_ef);
+        found = parallel_graph_nearest(*graph, *querySet, k, num_workers, nearest_i, nearest_d);
+    } else if(distance_metric[0] == 'E' && search_dimensionality > SpatialIndex::max_kd_tree_dims) {
+        found = batch_nearest(*searchSet, *querySet, k, nearest_i, nearest_d, num_workers);
+    } else if(distance_metric[0] == 'E') {
+        index = SpatialIndex::build(*searchSet);
+        found = parallel_nearest(*searchSet, index, *querySet, k, EUCLIDEAN_METRIC, num_workers, nearest_i, nearest_d);
+    } else if(distance_metric[0] == 'A') {
+        //unit length training inputs turn each query into one matrix-vector product
+        searchSet->cache_unit_inputs();
+        found = parallel_nearest(*searchSet, NULL, *querySet, k, ANGULAR_METRIC, num_workers, nearest_i, nearest_d);
+    } else {
+        cerr << "wth\n";
+    }
+    if(found < k) {
+        cerr << argv[0] << " error: could not find the nearest neighbors." << endl;
+        return (-1);
+    }
     ofstream output_file_str(trim(output_file).c_str());
+    FormattedWriter output_writer(output_file_str);
     double totalSSE = 0;
     for(int i = 0; i < num_testing; i++) {
         //input vector
@@ -113,16 +185,9 @@ int main(int argc, char** argv) {
             cerr << argv[0] << " error: issue copying input vector\n";
         }
 
-        //order the sets by distance metric
-        if(distance_metric[0] == 'E') {
-            //euclidean distance
-            pset->sort_euclidean(input_vector);
-        } else if(distance_metric[0] == 'A') {
-            //angular distance
-            pset->sort_angular(input_vector);
-        } else {
-            cerr << "wth\n";
-        }
+        //the k nearest neighbors of this test pattern
+        int* row_i = nearest_i + i * k;
+        double* row_d = nearest_d + i * k;
 
         //choose the K-nearest neighbors
         //create classification based on output method
@@ -131,11 +196,11 @@ int main(int argc, char** argv) {
         bool special_case = false;
         int k_special = 0;
         for(int j = 0; j < k; j++) {
-            pset->target_pattern(pset->get_permuted_i(j), neighbor_i);
+            pset->target_pattern(row_i[j], neighbor_i);
 
             //scale the vector if we're doing weighted mean
             if(output_method[0] == 'W') {
-                double weight = pow(pset->get_distance(pset->get_permuted_i(j)), 2);
+                double weight = pow(row_d[j], 2);
                 if(weight != 0 && !special_case) { //as soon as we hit a "special_case" never consider non 0 weighted vectors
                     weight_sum += 1.0/weight;
                     gsl_vector_scale(neighbor_i, 1.0/weight);
@@ -169,16 +234,35 @@ int main(int argc, char** argv) {
         totalSSE += sse;
 
         //Output to the file
-        for(int j = 0; j < input_dimensionality; j++)
-            output_file_str << gsl_vector_get(input_vector, j) << " ";
-        for(int j = 0; j < output_dimensionality; j++)
-            output_file_str << gsl_vector_get(output, j) << " ";
-        for(int j = 0; j < output_dimensionality; j++)
-            output_file_str << gsl_vector_get(target_vector, j) << " ";
-        output_file_str << sse << endl;
+        for(int j = 0; j < input_dimensionality; j++) {
+            output_writer.put_general(gsl_vector_get(input_vector, j));
+            output_writer.put(' ');
+        }
+        for(int j = 0; j < output_dimensionality; j++) {
+            output_writer.put_general(gsl_vector_get(output, j));
+            output_writer.put(' ');
+        }
+        for(int j = 0; j < output_dimensionality; j++) {
+            output_writer.put_general(gsl_vector_get(target_vector, j));
+            output_writer.put(' ');
+        }
+        output_writer.put_general(sse);
+        output_writer.put('\n');
     }
-    output_file_str << totalSSE << endl;
+    output_writer.put_general(totalSSE);
+    output_writer.put('\n');
+    if(!output_writer.flush())
+        cerr << argv[0] << " error: could not write the output file." << endl;
     output_file_str.close();
+    delete index;
+    delete graph;
+    if(pca) {
+        delete searchSet;
+        delete querySet;
+        delete pca;
+    }
+    delete [] nearest_i;
+    delete [] nearest_d;
     /* // Read the target vector ... */
     /* target_vector = gsl_vector_alloc(input_dimensionality); */
     /* cout << "Enter the target vector, with elements separated by whitespace:" */
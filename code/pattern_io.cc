@@ -0,0 +1,875 @@
+//
+// pattern_io.cc :  Implementation file for fast reading and writing of
+//                  "pattern set" files.
+//
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+
+#include <gsl/gsl_matrix.h>
+
+#include "patterns.h"
+#include "pattern_io.h"
+#include "pca_model.h"
+
+
+// BinaryPatternHeader -- The header at the start of a binary pattern file.
+struct BinaryPatternHeader {
+    char magic[8];            // identifies the file format
+    uint32_t byte_order;      // "binary_byte_order", as written
+    uint32_t version;         // format version
+    uint64_t n_patterns;      // number of patterns
+    uint32_t n_inputs;        // number of input values in each pattern
+    uint32_t n_targets;       // number of target values in each pattern
+    uint64_t inputs_offset;   // file offset of the input vectors
+    uint64_t targets_offset;  // file offset of the target vectors
+};
+
+// the first bytes of every binary pattern file ...
+static const char binary_pattern_magic[8]
+    = { 'P', 'A', 'T', 'S', 'E', 'T', 'B', '\0' };
+
+// a value that reads differently under the other byte order ...
+static const uint32_t binary_byte_order = 0x01020304;
+
+
+//
+// Utility Functions
+//
+
+// is_space -- Return true if the given character separates values.
+static inline bool is_space(char c) {
+    return ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') ||
+            (c == '\v') || (c == '\f'));
+}
+
+
+// Powers of ten that are exactly representable as doubles ...
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+// parse_double -- Parse the number starting at "p", which must not extend
+//                 past "end", storing it in "value" and advancing "p" past
+//                 it.  Numbers whose digits and exponent are both small
+//                 enough are converted with a single exact multiplication
+//                 or division, which is correctly rounded.  Any other
+//                 number is handed to "strtod".  Return false if no number
+//                 could be parsed.
+static bool parse_double(const char*& p, const char* end, double* value) {
+    const char* start = p;
+    const char* s = p;
+    bool negative = false;
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+
+    if ((s < end) && ((*s == '-') || (*s == '+'))) {
+        negative = (*s == '-');
+        s++;
+    }
+    // integer part, ignoring leading zeros ...
+    for (; (s < end) && (*s >= '0') && (*s <= '9'); s++) {
+        if ((mantissa == 0) && (*s == '0'))
+            continue;
+        mantissa = mantissa * 10 + (*s - '0');
+        digits++;
+    }
+    bool any_digits = (s > start) && (s[-1] >= '0') && (s[-1] <= '9');
+    // fractional part ...
+    if ((s < end) && (*s == '.')) {
+        s++;
+        for (; (s < end) && (*s >= '0') && (*s <= '9'); s++) {
+            any_digits = true;
+            if ((mantissa == 0) && (*s == '0')) {
+                exponent--;
+                continue;
+            }
+            mantissa = mantissa * 10 + (*s - '0');
+            digits++;
+            exponent--;
+        }
+    }
+    if (!any_digits)
+        return (false);
+    // exponent ...
+    if ((s < end) && ((*s == 'e') || (*s == 'E'))) {
+        const char* e = s + 1;
+        bool exp_negative = false;
+        int exp_value = 0;
+        if ((e < end) && ((*e == '-') || (*e == '+'))) {
+            exp_negative = (*e == '-');
+            e++;
+        }
+        if ((e < end) && (*e >= '0') && (*e <= '9')) {
+            for (; (e < end) && (*e >= '0') && (*e <= '9'); e++)
+                if (exp_value < 10000)
+                    exp_value = exp_value * 10 + (*e - '0');
+            exponent += exp_negative ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+    // the token must end at a separator ...
+    if ((s < end) && !is_space(*s))
+        return (false);
+    if ((digits <= 15) && (exponent >= -22) && (exponent <= 22)) {
+        // both the mantissa and the power of ten are exact doubles ...
+        double result = (double) mantissa;
+        if (exponent < 0)
+            result /= exact_powers_of_ten[-exponent];
+        else
+            result *= exact_powers_of_ten[exponent];
+        *value = negative ? -result : result;
+    } else {
+        // fall back on the library for long or extreme numbers ...
+        std::string token(start, s - start);
+        *value = strtod(token.c_str(), NULL);
+    }
+    p = s;
+    return (true);
+}
+
+
+// skip_space -- Advance "p" past any separators, stopping at "end".
+static inline void skip_space(const char*& p, const char* end) {
+    while ((p < end) && is_space(*p))
+        p++;
+}
+
+
+// parse_rows -- Parse complete patterns from the text between "p" and
+//               "end" into rows "first_row" onward of the given matrices,
+//               stopping after "n_rows" patterns.  If "by_line" is true,
+//               each pattern must occupy exactly one line.  Return the
+//               number of patterns parsed.
+static int parse_rows(const char* p, const char* end, gsl_matrix* inputs_m,
+        gsl_matrix* targets_m, int first_row, int n_rows, bool by_line) {
+    int n_inputs = inputs_m ? (int) inputs_m->size2 : 0;
+    int n_targets = targets_m ? (int) targets_m->size2 : 0;
+    int row;
+
+    for (row = first_row; row < first_row + n_rows; row++) {
+        double* in = inputs_m ? gsl_matrix_ptr(inputs_m, row, 0) : NULL;
+        double* targ = targets_m ? gsl_matrix_ptr(targets_m, row, 0) : NULL;
+        if (by_line) {
+            // skip blank lines ...
+            while ((p < end) && is_space(*p))
+                p++;
+        }
+        for (int j = 0; j < n_inputs + n_targets; j++) {
+            if (by_line) {
+                while ((p < end) && is_space(*p) && (*p != '\n'))
+                    p++;
+            } else {
+                skip_space(p, end);
+            }
+            double* dest = (j < n_inputs) ? (in + j) : (targ + j - n_inputs);
+            if ((p >= end) || !parse_double(p, end, dest))
+                return (row - first_row);
+        }
+        if (by_line) {
+            // nothing but separators may follow on the line ...
+            while ((p < end) && is_space(*p) && (*p != '\n'))
+                p++;
+            if ((p < end) && (*p != '\n'))
+                return (row - first_row);
+        }
+    }
+    return (row - first_row);
+}
+
+
+// map_text_file -- Map the named file into memory for reading from start
+//                  to end, storing its length in "length".  Return NULL if
+//                  the file cannot be mapped or is empty.
+static void* map_text_file(const char* file_name, size_t* length) {
+    struct stat file_stat;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return (NULL);
+    if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size == 0)) {
+        (void) close(fd);
+        return (NULL);
+    }
+    *length = (size_t) file_stat.st_size;
+    void* mapping = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+    (void) close(fd);
+    if (mapping == MAP_FAILED)
+        return (NULL);
+    (void) madvise(mapping, *length, MADV_SEQUENTIAL);
+    return (mapping);
+}
+
+
+// is_binary_pattern_file -- Return true if the given file contents begin
+//                           like a binary pattern file.
+static bool is_binary_pattern_file(const void* mapping, size_t length) {
+    return ((length >= sizeof(binary_pattern_magic)) &&
+            (memcmp(mapping, binary_pattern_magic,
+                    sizeof(binary_pattern_magic)) == 0));
+}
+
+
+// LoadChunk -- The share of a file parsed by one worker thread.
+struct LoadChunk {
+    const char* begin;        // first character of the chunk
+    const char* end;          // one past the last character
+    int first_row;            // pattern number of the first line
+    int n_rows;               // number of patterns in the chunk
+    gsl_matrix* inputs_m;
+    gsl_matrix* targets_m;
+    int n_parsed;             // number of patterns actually parsed
+};
+
+
+// count_rows -- Return the number of non-blank lines between "p" and
+//               "end".
+static int count_rows(const char* p, const char* end) {
+    int count = 0;
+    bool blank = true;
+
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            count += !blank;
+            blank = true;
+        } else if (!is_space(*p)) {
+            blank = false;
+        }
+    }
+    return (count + !blank);
+}
+
+
+// split_at_lines -- Cut the text between "text" and "text_end" into
+//                   "n_chunks" roughly equal chunks, each ending after a
+//                   newline (or at the end of the text), filling "bounds"
+//                   with the start of each chunk followed by the end of the
+//                   text.
+static void split_at_lines(const char* text, const char* text_end,
+        int n_chunks, vector<const char*>& bounds) {
+    size_t length = text_end - text;
+    const char* p = text;
+
+    bounds.assign(1, text);
+    for (int c = 0; c < n_chunks; c++) {
+        if (c == n_chunks - 1) {
+            p = text_end;
+        } else {
+            const char* start = p;
+            p = text + (length * (c + 1)) / n_chunks;
+            if (p < start)
+                p = start;
+            const char* newline = (const char*) memchr(p, '\n', text_end - p);
+            p = newline ? (newline + 1) : text_end;
+        }
+        bounds.push_back(p);
+    }
+}
+
+
+// load_chunk_worker -- Parse the patterns of a single chunk.
+static void* load_chunk_worker(void* arg) {
+    LoadChunk* chunk = (LoadChunk*) arg;
+
+    chunk->n_parsed = parse_rows(chunk->begin, chunk->end, chunk->inputs_m,
+            chunk->targets_m, chunk->first_row, chunk->n_rows, true);
+    return (NULL);
+}
+
+
+// read_pattern_file -- Fill the given pattern set from the named text file
+//                      of whitespace separated values, as "operator>>"
+//                      does, but by mapping the file into memory and parsing
+//                      the numbers in place.  With more than one worker the
+//                      file is split across "n_workers" threads at line
+//                      boundaries, which requires exactly one pattern per
+//                      (non-blank) line.  Binary pattern files are
+//                      recognized and mapped in place instead.  Return false
+//                      if the file cannot be read or holds too few values.
+
+bool read_pattern_file(const char* file_name, PatternSet& pset, int n_workers) {
+    int n_patterns = pset.n_patterns;
+
+    if ((n_patterns <= 0) || (pset.inputs_m == NULL && pset.targets_m == NULL))
+        return (false);
+    size_t length;
+    void* mapping = map_text_file(file_name, &length);
+    if (mapping == NULL)
+        return (false);
+    const char* text = (const char*) mapping;
+    const char* text_end = text + length;
+    if (is_binary_pattern_file(mapping, length)) {
+        // a binary file is used in place rather than parsed ...
+        (void) munmap(mapping, length);
+        return (map_binary_pattern_file(file_name, pset));
+    }
+    // any cached input vector lengths are about to become stale ...
+    pset.clear_caches();
+
+    int n_parsed;
+    if (n_workers <= 1) {
+        n_parsed = parse_rows(text, text_end, pset.inputs_m, pset.targets_m,
+                0, n_patterns, false);
+    } else {
+        // cut the file into roughly equal chunks, each ending after a
+        // newline ...
+        vector<LoadChunk> chunks(n_workers);
+        vector<const char*> bounds;
+        split_at_lines(text, text_end, n_workers, bounds);
+        for (int w = 0; w < n_workers; w++) {
+            chunks[w].begin = bounds[w];
+            chunks[w].end = bounds[w + 1];
+        }
+        // number the lines of each chunk, ignoring any beyond the size of
+        // the pattern set ...
+        int row = 0;
+        for (int w = 0; w < n_workers; w++) {
+            int n_rows = count_rows(chunks[w].begin, chunks[w].end);
+            if (row + n_rows > n_patterns)
+                n_rows = n_patterns - row;
+            chunks[w].first_row = row;
+            chunks[w].n_rows = n_rows;
+            chunks[w].inputs_m = pset.inputs_m;
+            chunks[w].targets_m = pset.targets_m;
+            chunks[w].n_parsed = 0;
+            row += n_rows;
+        }
+        vector<pthread_t> threads(n_workers);
+        vector<bool> started(n_workers, false);
+        for (int w = 1; w < n_workers; w++)
+            started[w] = (pthread_create(&threads[w], NULL,
+                        load_chunk_worker, &chunks[w]) == 0);
+        (void) load_chunk_worker(&chunks[0]);
+        for (int w = 1; w < n_workers; w++) {
+            if (started[w])
+                (void) pthread_join(threads[w], NULL);
+            else
+                (void) load_chunk_worker(&chunks[w]);
+        }
+        // every chunk must have parsed all of its lines ...
+        n_parsed = row;
+        for (int w = 0; w < n_workers; w++)
+            if (chunks[w].n_parsed < chunks[w].n_rows)
+                n_parsed = 0;
+    }
+    (void) munmap(mapping, length);
+    return (n_parsed == n_patterns);
+}
+
+
+// read_unsized_pattern_file -- Fill the given pattern set from the named
+//                              text file, one pattern per (non-blank) line,
+//                              discovering the number of patterns and the
+//                              number of values per pattern in a single
+//                              pass.  Values are collected in storage that
+//                              grows geometrically, and are then moved into
+//                              vectors of exactly the right size.  One of
+//                              "num_inputs" and "num_targets" may be
+//                              negative, to take whatever values remain on
+//                              each line.  Binary pattern files are mapped
+//                              in place.  Any previous contents of the
+//                              pattern set are replaced.  Return false,
+//                              leaving the pattern set empty, if the file
+//                              cannot be read or its lines differ in length.
+
+bool read_unsized_pattern_file(const char* file_name, PatternSet& pset,
+        int num_inputs, int num_targets) {
+    if ((num_inputs < 0) && (num_targets < 0))
+        return (false);
+    size_t length;
+    void* mapping = map_text_file(file_name, &length);
+    if (mapping == NULL)
+        return (false);
+    // start from an empty pattern set, which a binary file may fill ...
+    pset.release_storage();
+    pset.n_patterns = 0;
+    pset.n_inputs = 0;
+    pset.n_targets = 0;
+    pset.permute = false;
+    if (is_binary_pattern_file(mapping, length)) {
+        (void) munmap(mapping, length);
+        if (map_binary_pattern_file(file_name, pset) &&
+                ((num_inputs < 0) || (pset.n_inputs == num_inputs)) &&
+                ((num_targets < 0) || (pset.n_targets == num_targets)))
+            return (true);
+        (void) pset.allocate_storage(0, 0, 0);
+        return (false);
+    }
+
+    const char* p = (const char*) mapping;
+    const char* end = p + length;
+    vector<double> values;
+    int n_rows = 0;
+    int n_cols = -1;
+    bool valid = true;
+    while (valid) {
+        // skip blank lines ...
+        skip_space(p, end);
+        if (p >= end)
+            break;
+        // parse the values on this line ...
+        int count = 0;
+        while ((p < end) && (*p != '\n')) {
+            if (is_space(*p)) {
+                p++;
+                continue;
+            }
+            double value;
+            if (!parse_double(p, end, &value)) {
+                valid = false;
+                break;
+            }
+            // "push_back" grows the storage geometrically ...
+            values.push_back(value);
+            count++;
+        }
+        // the first line decides the length of every pattern ...
+        if (n_cols < 0)
+            n_cols = count;
+        else if (count != n_cols)
+            valid = false;
+        n_rows++;
+    }
+    (void) munmap(mapping, length);
+    // split each line into inputs and targets ...
+    int n_in = num_inputs;
+    int n_targ = num_targets;
+    if (n_in < 0)
+        n_in = n_cols - n_targ;
+    if (n_targ < 0)
+        n_targ = n_cols - n_in;
+    if (!valid || (n_rows == 0) || (n_in < 0) || (n_targ < 0) ||
+            (n_in + n_targ != n_cols) ||
+            !pset.allocate_storage(n_rows, n_in, n_targ)) {
+        (void) pset.allocate_storage(0, 0, 0);
+        return (false);
+    }
+    // move the values into storage of exactly the right size ...
+    const double* row = &values[0];
+    for (int i = 0; i < n_rows; i++) {
+        if (n_in > 0)
+            memcpy(gsl_matrix_ptr(pset.inputs_m, i, 0), row,
+                    n_in * sizeof(double));
+        if (n_targ > 0)
+            memcpy(gsl_matrix_ptr(pset.targets_m, i, 0), row + n_in,
+                    n_targ * sizeof(double));
+        row += n_cols;
+    }
+    return (true);
+}
+
+
+// aligned_offset -- Round the given file offset up to the alignment of the
+//                   vector blocks.
+static uint64_t aligned_offset(uint64_t offset) {
+    return (((offset + binary_pattern_alignment - 1) / binary_pattern_alignment)
+            * binary_pattern_alignment);
+}
+
+
+// write_matrix_rows -- Write the rows of the given matrix contiguously to
+//                      the given file, returning false on error.
+static bool write_matrix_rows(FILE* file, const gsl_matrix* m) {
+    if (m == NULL)
+        return (true);
+    for (size_t i = 0; i < m->size1; i++)
+        if (fwrite(gsl_matrix_const_ptr(m, i, 0), sizeof(double), m->size2,
+                    file) != m->size2)
+            return (false);
+    return (true);
+}
+
+
+// write_padding -- Write zero bytes to the given file until its position
+//                  reaches "offset", returning false on error.
+static bool write_padding(FILE* file, uint64_t position, uint64_t offset) {
+    static const char zeros[binary_pattern_alignment] = { 0 };
+
+    return ((offset == position) ||
+            (fwrite(zeros, 1, offset - position, file) == offset - position));
+}
+
+
+// write_binary_pattern_file -- Write the given pattern set to the named
+//                              file in the binary pattern format, with the
+//                              patterns in their original order.  The
+//                              file is replaced only once it is complete.
+//                              Return false on error.
+
+bool write_binary_pattern_file(const char* file_name, const PatternSet& pset) {
+    BinaryPatternHeader header;
+
+    if (pset.number_of_patterns() < 0)
+        return (false);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, binary_pattern_magic, sizeof(header.magic));
+    header.byte_order = binary_byte_order;
+    header.version = binary_pattern_version;
+    header.n_patterns = pset.number_of_patterns();
+    header.n_inputs = pset.number_of_inputs();
+    header.n_targets = pset.number_of_targets();
+    uint64_t inputs_bytes = header.n_patterns * header.n_inputs * sizeof(double);
+    header.inputs_offset = aligned_offset(sizeof(header));
+    header.targets_offset = aligned_offset(header.inputs_offset + inputs_bytes);
+
+    // write a temporary file beside the named one and rename it into place
+    // once it is complete, so that a reader (or a mapping of the old file)
+    // never sees a partly written pattern set ...
+    string temp_name = string(file_name) + ".XXXXXX";
+    vector<char> temp_buffer(temp_name.begin(), temp_name.end());
+    temp_buffer.push_back('\0');
+    int fd = mkstemp(&temp_buffer[0]);
+    if (fd < 0)
+        return (false);
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL) {
+        (void) close(fd);
+        (void) unlink(&temp_buffer[0]);
+        return (false);
+    }
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        write_padding(file, sizeof(header), header.inputs_offset) &&
+        write_matrix_rows(file, pset.input_matrix()) &&
+        write_padding(file, header.inputs_offset + inputs_bytes,
+                header.targets_offset) &&
+        write_matrix_rows(file, pset.target_matrix()) &&
+        (fflush(file) == 0) && (fsync(fd) == 0);
+    // "mkstemp" leaves the file private to its owner ...
+    mode_t mask = umask(0);
+    (void) umask(mask);
+    if (fchmod(fd, 0666 & ~mask) != 0)
+        ok = false;
+    if (fclose(file) != 0)
+        ok = false;
+    if (ok && (rename(&temp_buffer[0], file_name) != 0))
+        ok = false;
+    if (!ok)
+        (void) unlink(&temp_buffer[0]);
+    return (ok);
+}
+
+
+// wrap_matrix -- Return a matrix that refers to the given rows of doubles
+//                without owning them, or NULL if there are no columns.
+static gsl_matrix* wrap_matrix(double* data, size_t rows, size_t cols) {
+    if ((rows == 0) || (cols == 0))
+        return (NULL);
+    // "gsl_matrix_free" releases the structure itself with "free", and
+    // leaves the data alone, since the matrix does not own it ...
+    gsl_matrix* m = (gsl_matrix*) malloc(sizeof(gsl_matrix));
+    if (m) {
+        m->size1 = rows;
+        m->size2 = cols;
+        m->tda = cols;
+        m->data = data;
+        m->block = NULL;
+        m->owner = 0;
+    }
+    return (m);
+}
+
+
+// rows_fit_in_file -- Return true if "rows" rows of "cols" doubles each,
+//                     starting "offset" bytes into a file of "length"
+//                     bytes, lie within the file.  No sum or product is
+//                     formed that could wrap around for a corrupt header.
+
+static bool rows_fit_in_file(uint64_t offset, uint64_t rows, uint64_t cols,
+        uint64_t length) {
+    if (offset > length)
+        return (false);
+    if (cols == 0)
+        return (true);
+    return (rows <= (length - offset) / (cols * sizeof(double)));
+}
+
+
+// map_binary_pattern_file -- Make the given pattern set use the vectors of
+//                            the named binary pattern file in place, by
+//                            mapping the file into memory.  An empty pattern
+//                            set takes on the size of the file.  Otherwise
+//                            the file must have the same numbers of inputs
+//                            and targets, and at least as many patterns, and
+//                            only that many patterns are used.  Changes to
+//                            the pattern set are never written back to the
+//                            file.  Return false on error, leaving the
+//                            pattern set unchanged.
+
+bool map_binary_pattern_file(const char* file_name, PatternSet& pset) {
+    struct stat file_stat;
+    BinaryPatternHeader header;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return (false);
+    if ((fstat(fd, &file_stat) != 0) ||
+            ((size_t) file_stat.st_size < sizeof(header))) {
+        (void) close(fd);
+        return (false);
+    }
+    size_t length = (size_t) file_stat.st_size;
+    // a private, writable mapping lets the pattern set be modified without
+    // copying any page that is not written to ...
+    void* mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fd, 0);
+    (void) close(fd);
+    if (mapping == MAP_FAILED)
+        return (false);
+    memcpy(&header, mapping, sizeof(header));
+    // the targets follow the inputs, so that the two blocks cannot overlap;
+    // the size of the input block is only computed once it is known to fit
+    // in the file ...
+    bool valid = (memcmp(header.magic, binary_pattern_magic,
+                sizeof(header.magic)) == 0) &&
+        (header.byte_order == binary_byte_order) &&
+        (header.version == binary_pattern_version) &&
+        (header.n_patterns > 0) && (header.n_patterns <= 0x7fffffff) &&
+        (header.n_inputs <= 0x7fffffff) && (header.n_targets <= 0x7fffffff) &&
+        (header.inputs_offset % sizeof(double) == 0) &&
+        (header.targets_offset % sizeof(double) == 0) &&
+        (header.inputs_offset >= sizeof(header)) &&
+        rows_fit_in_file(header.inputs_offset, header.n_patterns,
+                header.n_inputs, length) &&
+        rows_fit_in_file(header.targets_offset, header.n_patterns,
+                header.n_targets, length) &&
+        (header.targets_offset >= header.inputs_offset) &&
+        (header.targets_offset - header.inputs_offset >=
+         header.n_patterns * header.n_inputs * sizeof(double));
+    int num_pat = (int) header.n_patterns;
+    if (valid && (pset.n_patterns != 0)) {
+        // a sized pattern set takes only the patterns it has room for ...
+        valid = (pset.n_patterns > 0) && (pset.n_patterns <= num_pat) &&
+            (pset.n_inputs == (int) header.n_inputs) &&
+            (pset.n_targets == (int) header.n_targets);
+        num_pat = pset.n_patterns;
+    }
+    int* permutation = valid ? new int[num_pat] : NULL;
+    gsl_matrix* inputs_m = NULL;
+    gsl_matrix* targets_m = NULL;
+    if (valid) {
+        char* base = (char*) mapping;
+        inputs_m = wrap_matrix((double*) (base + header.inputs_offset),
+                num_pat, header.n_inputs);
+        targets_m = wrap_matrix((double*) (base + header.targets_offset),
+                num_pat, header.n_targets);
+        valid = (permutation != NULL) &&
+            ((header.n_inputs == 0) || inputs_m) &&
+            ((header.n_targets == 0) || targets_m);
+    }
+    if (!valid) {
+        if (permutation)
+            delete [] permutation;
+        if (inputs_m)
+            gsl_matrix_free(inputs_m);
+        if (targets_m)
+            gsl_matrix_free(targets_m);
+        (void) munmap(mapping, length);
+        return (false);
+    }
+    // replace the contents of the pattern set ...
+    pset.release_storage();
+    pset.n_patterns = num_pat;
+    pset.n_inputs = (int) header.n_inputs;
+    pset.n_targets = (int) header.n_targets;
+    pset.inputs_m = inputs_m;
+    pset.targets_m = targets_m;
+    pset.permute = true;
+    pset.permutation = permutation;
+    for (int i = 0; i < num_pat; i++)
+        pset.permutation[i] = i;
+    pset.mapped_data = mapping;
+    pset.mapped_length = length;
+    pset.n_allocated = num_pat;
+    return (true);
+}
+
+
+// AccumulateChunk -- The share of a pattern file added to a covariance
+//                    accumulator by one worker thread.
+struct AccumulateChunk {
+    const char* begin;        // first character of the chunk (text files)
+    const char* end;          // one past the last character
+    const gsl_matrix* inputs_m;  // the mapped input vectors (binary files)
+    int first_row;            // first pattern of the chunk (binary files)
+    int end_row;              // one past the last pattern
+    int n_targets;            // number of target values in each pattern
+    int chunk_patterns;       // number of patterns added at a time
+    CovarianceAccumulator* acc;  // the accumulator for this chunk alone
+    bool ok;                  // true once every pattern has been added
+};
+
+
+// skip_rows -- Return the position just after the first "n_rows" non-blank
+//              lines following "p", or "end" if there are fewer, setting
+//              "n_found" to the number of non-blank lines passed.
+static const char* skip_rows(const char* p, const char* end, int n_rows,
+        int* n_found) {
+    int count = 0;
+    bool blank = true;
+
+    for (; (p < end) && (count < n_rows); p++) {
+        if (*p == '\n') {
+            count += !blank;
+            blank = true;
+        } else if (!is_space(*p)) {
+            blank = false;
+        }
+    }
+    *n_found = count + !blank;
+    return (p);
+}
+
+
+// accumulate_text_worker -- Parse the patterns of a single chunk of a text
+//                           file a block at a time, adding the input
+//                           vectors of each block to the chunk's
+//                           accumulator.
+static void* accumulate_text_worker(void* arg) {
+    AccumulateChunk* chunk = (AccumulateChunk*) arg;
+    int n_inputs = chunk->acc->number_of_inputs();
+    gsl_matrix* inputs_m = gsl_matrix_alloc(chunk->chunk_patterns, n_inputs);
+    gsl_matrix* targets_m = (chunk->n_targets > 0) ?
+        gsl_matrix_alloc(chunk->chunk_patterns, chunk->n_targets) : NULL;
+
+    chunk->ok = (inputs_m != NULL) &&
+        ((chunk->n_targets == 0) || (targets_m != NULL));
+    const char* p = chunk->begin;
+    while (chunk->ok && (p < chunk->end)) {
+        int n_rows;
+        const char* block_end = skip_rows(p, chunk->end, chunk->chunk_patterns,
+                &n_rows);
+        if (n_rows == 0)
+            break;
+        if (parse_rows(p, block_end, inputs_m, targets_m, 0, n_rows, true) <
+                n_rows) {
+            chunk->ok = false;
+        } else {
+            gsl_matrix_const_view rows_m_view
+                = gsl_matrix_const_submatrix(inputs_m, 0, 0, n_rows, n_inputs);
+            chunk->ok = chunk->acc->add(&rows_m_view.matrix);
+        }
+        p = block_end;
+    }
+    if (inputs_m)
+        gsl_matrix_free(inputs_m);
+    if (targets_m)
+        gsl_matrix_free(targets_m);
+    return (NULL);
+}
+
+
+// accumulate_binary_worker -- Add the mapped input vectors of a single
+//                             chunk of a binary file to the chunk's
+//                             accumulator, a block at a time.
+static void* accumulate_binary_worker(void* arg) {
+    AccumulateChunk* chunk = (AccumulateChunk*) arg;
+
+    chunk->ok = true;
+    for (int row = chunk->first_row; chunk->ok && (row < chunk->end_row);
+            row += chunk->chunk_patterns) {
+        int n_rows = chunk->end_row - row;
+        if (n_rows > chunk->chunk_patterns)
+            n_rows = chunk->chunk_patterns;
+        gsl_matrix_const_view rows_m_view = gsl_matrix_const_submatrix(
+                chunk->inputs_m, row, 0, n_rows, chunk->inputs_m->size2);
+        chunk->ok = chunk->acc->add(&rows_m_view.matrix);
+    }
+    return (NULL);
+}
+
+
+// accumulate_pattern_file -- Add the input vectors of the named pattern file
+//                            to the given accumulator in a single pass,
+//                            "chunk_patterns" patterns at a time, so that
+//                            the file never needs to fit in memory.  The
+//                            file is split across "n_workers" threads, each
+//                            with an accumulator of its own, and their
+//                            results are merged.  Return false on error,
+//                            leaving the accumulator unchanged.
+
+bool accumulate_pattern_file(const char* file_name, CovarianceAccumulator& acc,
+        int num_targets, int n_workers, int chunk_patterns) {
+    int n_inputs = acc.number_of_inputs();
+
+    if ((n_inputs <= 0) || (num_targets < 0) || (chunk_patterns <= 0))
+        return (false);
+    if (n_workers < 1)
+        n_workers = 1;
+    size_t length;
+    void* mapping = map_text_file(file_name, &length);
+    if (mapping == NULL)
+        return (false);
+    const char* text = (const char*) mapping;
+    PatternSet mapped;
+    vector<const char*> bounds;
+    bool binary = is_binary_pattern_file(mapping, length);
+    if (binary) {
+        // a binary file is used in place rather than parsed ...
+        (void) munmap(mapping, length);
+        mapping = NULL;
+        if (!map_binary_pattern_file(file_name, mapped) ||
+                (mapped.number_of_inputs() != n_inputs))
+            return (false);
+    } else {
+        // the text is read once, from start to end ...
+        (void) madvise(mapping, length, MADV_SEQUENTIAL);
+        split_at_lines(text, text + length, n_workers, bounds);
+    }
+    vector<AccumulateChunk> chunks(n_workers);
+    int n_patterns = binary ? mapped.number_of_patterns() : 0;
+    bool ok = true;
+    for (int w = 0; w < n_workers; w++) {
+        chunks[w].begin = binary ? NULL : bounds[w];
+        chunks[w].end = binary ? NULL : bounds[w + 1];
+        chunks[w].inputs_m = mapped.input_matrix();
+        chunks[w].first_row = (int) (((long) n_patterns * w) / n_workers);
+        chunks[w].end_row = (int) (((long) n_patterns * (w + 1)) / n_workers);
+        chunks[w].n_targets = num_targets;
+        chunks[w].chunk_patterns = chunk_patterns;
+        chunks[w].acc = new CovarianceAccumulator(n_inputs);
+        chunks[w].ok = false;
+        if (chunks[w].acc->number_of_inputs() != n_inputs)
+            ok = false;
+    }
+    if (ok) {
+        void* (*worker)(void*) = binary ? accumulate_binary_worker :
+            accumulate_text_worker;
+        vector<pthread_t> threads(n_workers);
+        vector<bool> started(n_workers, false);
+        for (int w = 1; w < n_workers; w++)
+            started[w] = (pthread_create(&threads[w], NULL, worker,
+                        &chunks[w]) == 0);
+        (void) worker(&chunks[0]);
+        for (int w = 1; w < n_workers; w++) {
+            if (started[w])
+                (void) pthread_join(threads[w], NULL);
+            else
+                (void) worker(&chunks[w]);
+        }
+        for (int w = 0; w < n_workers; w++)
+            ok = ok && chunks[w].ok;
+    }
+    // merge the chunks in order, only once all of them have succeeded ...
+    for (int w = 0; w < n_workers; w++) {
+        if (ok)
+            ok = acc.merge(*chunks[w].acc);
+        delete chunks[w].acc;
+    }
+    if (mapping)
+        (void) munmap(mapping, length);
+    return (ok);
+}
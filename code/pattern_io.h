@@ -0,0 +1,110 @@
+//
+// pattern_io.h :  Specification file for fast reading and writing of
+//                 "pattern set" files.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef PATTERN_IO_INCLUDED
+#define PATTERN_IO_INCLUDED 1
+
+
+#include "patterns.h"
+
+
+class CovarianceAccumulator;
+
+
+// read_pattern_file -- Fill the given pattern set from the named text file
+//                      of whitespace separated values, as "operator>>"
+//                      does, but by mapping the file into memory and parsing
+//                      the numbers in place.  With more than one worker the
+//                      file is split across "n_workers" threads at line
+//                      boundaries, which requires exactly one pattern per
+//                      (non-blank) line.  Binary pattern files, described
+//                      below, are recognized and mapped in place instead.
+//                      Return false if the file cannot be read or holds too
+//                      few values.
+bool read_pattern_file(const char* file_name, PatternSet& pset,
+        int n_workers = 1);
+
+
+// read_unsized_pattern_file -- Fill the given pattern set from the named
+//                              text file, one pattern per (non-blank) line,
+//                              discovering the number of patterns and the
+//                              number of values per pattern in a single pass
+//                              rather than requiring them in advance.  One
+//                              of "num_inputs" and "num_targets" may be
+//                              negative, to take whatever values remain on
+//                              each line.  Binary pattern files are mapped
+//                              in place.  Any previous contents of the
+//                              pattern set are replaced.  Return false,
+//                              leaving the pattern set empty, if the file
+//                              cannot be read or its lines differ in length.
+bool read_unsized_pattern_file(const char* file_name, PatternSet& pset,
+        int num_inputs, int num_targets);
+
+
+//
+// Binary Pattern Files  --  A pattern set may also be stored in a binary
+//                           file that can be used in place, without any
+//                           parsing.  The file holds a fixed header giving
+//                           the number of patterns, inputs and targets,
+//                           followed by the input vectors and then the
+//                           target vectors, each block stored row by row as
+//                           native doubles and starting on a multiple of
+//                           "binary_pattern_alignment" bytes.  Files are
+//                           only readable on machines with the same byte
+//                           order as the one that wrote them.
+//
+
+// current version of the binary pattern file format
+const unsigned int binary_pattern_version = 1;
+
+// alignment of the vector blocks within a binary pattern file, in bytes
+const unsigned int binary_pattern_alignment = 64;
+
+// write_binary_pattern_file -- Write the given pattern set to the named
+//                              file in the binary pattern format, with the
+//                              patterns in their original order.  The
+//                              file is replaced only once it is complete.
+//                              Return false on error.
+bool write_binary_pattern_file(const char* file_name, const PatternSet& pset);
+
+// map_binary_pattern_file -- Make the given pattern set use the vectors of
+//                            the named binary pattern file in place, by
+//                            mapping the file into memory.  An empty pattern
+//                            set takes on the size of the file.  Otherwise
+//                            the file must have the same numbers of inputs
+//                            and targets, and at least as many patterns, and
+//                            only that many patterns are used.  Changes to
+//                            the pattern set are never written back to the
+//                            file.  Return false on error, leaving the
+//                            pattern set unchanged.
+bool map_binary_pattern_file(const char* file_name, PatternSet& pset);
+
+
+// default number of patterns parsed and added at a time by
+// "accumulate_pattern_file"
+const int default_accumulate_chunk = 4096;
+
+// accumulate_pattern_file -- Add the input vectors of the named pattern
+//                            file, text or binary, to the given covariance
+//                            accumulator in a single pass, parsing and
+//                            adding "chunk_patterns" patterns at a time so
+//                            that the file never has to fit in memory.  A
+//                            text file must hold one pattern per
+//                            non-blank line, of as many input values as
+//                            the accumulator expects followed by
+//                            "num_targets" target values.  The file is
+//                            split across "n_workers" threads, each with
+//                            an accumulator of its own, and their results
+//                            are merged.  Several files may be added to
+//                            the same accumulator in turn.  Return false
+//                            on error, leaving the accumulator unchanged.
+bool accumulate_pattern_file(const char* file_name, CovarianceAccumulator& acc,
+        int num_targets, int n_workers = 1,
+        int chunk_patterns = default_accumulate_chunk);
+
+
+#endif  // #ifndef PATTERN_IO_INCLUDED
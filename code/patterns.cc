@@ -7,67 +7,243 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <pthread.h>
 
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_sort_double.h>
-#include <gsl/gsl_statistics_double.h>
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_eigen.h>
 
 #include "patterns.h"
+#include "pca_model.h"
+#include "distance.h"
+#include "formatted_writer.h"
 
 
 //
-// PatternSet Class  --  Member function implementations
+// QueryWorkspace Class  --  Member function implementations
 //
 
-// constructors
+QueryWorkspace::QueryWorkspace(int num_pat) {
+    size = 0;
+    order = NULL;
+    distances = NULL;
+    visit_epoch = 0;
+    (void) reserve(num_pat);
+}
 
-PatternSet::PatternSet(int num_pat, int num_inputs, int num_targets) {
-    n_patterns = num_pat;
-    n_inputs = num_inputs;
-    n_targets = num_targets;
-    // permutation sequence default values ...
-    if (n_patterns > 0) {
-        permute = true;
-        if (permutation = new int[n_patterns])
-            // initialize permutation sequence ...
-            for (int i = 0; i < n_patterns; i++)
-                permutation[i] = i;
+QueryWorkspace::~QueryWorkspace() {
+    if (order)
+        delete [] order;
+    if (distances)
+        delete [] distances;
+    order = NULL;
+    distances = NULL;
+    size = 0;
+}
+
+
+// reserve -- Make sure that the workspace can hold at least the given
+//            number of patterns.  Return false on error.
+
+bool QueryWorkspace::reserve(int num_pat) {
+    if (num_pat <= size)
+        return (true);
+    if (order)
+        delete [] order;
+    if (distances)
+        delete [] distances;
+    order = new int[num_pat];
+    distances = new double[num_pat];
+    if (order && distances) {
+        size = num_pat;
+        return (true);
     } else {
-        permute = false;
-        permutation = NULL;
+        size = 0;
+        return (false);
     }
-    // allocate input vector storage ...
-    if ((n_patterns > 0) && (n_inputs > 0)) {
-        inputs_m = gsl_matrix_alloc(n_patterns, n_inputs);
-    } else {
-        inputs_m = NULL;
+}
+
+
+// begin_visits -- Start a graph search over "num_pat" patterns, none of
+//                 which has been visited yet.
+
+void QueryWorkspace::begin_visits(int num_pat) {
+    if ((int) visit_tags.size() < num_pat)
+        visit_tags.resize(num_pat, visit_epoch);
+    // every pattern carries an older tag than the new search, unless the
+    // tag has wrapped around, when every tag is cleared ...
+    if (++visit_epoch == 0) {
+        std::fill(visit_tags.begin(), visit_tags.end(), 0);
+        visit_epoch = 1;
     }
-    // allocate target vector storage ...
-    if ((n_patterns > 0) && (n_targets > 0)) {
-        targets_m = gsl_matrix_alloc(n_patterns, n_targets);
-    } else {
-        targets_m = NULL;
+}
+
+
+//
+// QuantizedInputs Class  --  Member function implementations
+//
+
+// number of code steps between the smallest and largest value in a column
+static const int quantized_code_steps = 255;
+
+QuantizedInputs::QuantizedInputs(const gsl_matrix* inputs_m, int capacity) {
+    n_rows = inputs_m->size1;
+    n_cols = inputs_m->size2;
+    n_allocated = (capacity > n_rows) ? capacity : n_rows;
+    codes = new unsigned char[(size_t) n_allocated * n_cols];
+    offset = new double[n_cols];
+    scale = new double[n_cols];
+    lengths = new double[n_allocated];
+    if (!codes || !offset || !scale || !lengths)
+        return;
+    // choose the offset and scale of each column from its range ...
+    for (int j = 0; j < n_cols; j++) {
+        double low = gsl_matrix_get(inputs_m, 0, j);
+        double high = low;
+        bool integral = true;
+        for (int i = 0; i < n_rows; i++) {
+            double x = gsl_matrix_get(inputs_m, i, j);
+            if (x < low)
+                low = x;
+            if (x > high)
+                high = x;
+            if (x != floor(x))
+                integral = false;
+        }
+        offset[j] = low;
+        if (high == low)
+            scale[j] = 0.0;
+        else if (integral && (high - low <= quantized_code_steps))
+            scale[j] = 1.0;
+        else
+            scale[j] = (high - low) / quantized_code_steps;
     }
-    // check for allocation failure ...
-    if ((n_patterns > 0) &&
-            ((permutation == NULL) ||
-             ((n_inputs > 0) && (inputs_m == NULL)) ||
-             ((n_targets > 0) && (targets_m == NULL)))) {
-        // invalidate this pattern set ...
-        n_patterns = -1;
-        n_inputs = -1;
-        n_targets = -1;
+    for (int i = 0; i < n_rows; i++)
+        (void) encode_row(i, gsl_matrix_const_ptr(inputs_m, i, 0));
+}
+
+QuantizedInputs::~QuantizedInputs() {
+    if (codes)
+        delete [] codes;
+    if (offset)
+        delete [] offset;
+    if (scale)
+        delete [] scale;
+    if (lengths)
+        delete [] lengths;
+}
+
+
+// encode_row -- Code the given input vector as the "i"th row, rounding each
+//               value to the nearest code step.  Return false if any of its
+//               values lie outside the range of its column.
+
+bool QuantizedInputs::encode_row(int i, const double* pat) {
+    unsigned char* row_codes = codes + (size_t) i * n_cols;
+    double length2 = 0.0;
+    bool in_range = true;
+
+    for (int j = 0; j < n_cols; j++) {
+        double code = 0.0;
+        if (scale[j] > 0.0)
+            code = floor((pat[j] - offset[j]) / scale[j] + 0.5);
+        else if (pat[j] != offset[j])
+            in_range = false;
+        // clamp codes that do not fit, including those of NaNs ...
+        if (!(code >= 0.0)) {
+            code = 0.0;
+            in_range = false;
+        } else if (code > quantized_code_steps) {
+            code = quantized_code_steps;
+            in_range = false;
+        }
+        row_codes[j] = (unsigned char) code;
+        double decoded = offset[j] + scale[j] * code;
+        length2 += decoded * decoded;
     }
+    lengths[i] = sqrt(length2);
+    return (in_range);
+}
+
+
+// grow_array -- Replace the given array with one of "size" elements holding
+//               the same first "used" elements.  Return false on error,
+//               leaving the array unchanged.
+template <class T>
+static bool grow_array(T*& array, size_t size, size_t used) {
+    T* grown = new T[size];
+    if (grown == NULL)
+        return (false);
+    if (array) {
+        for (size_t t = 0; t < used; t++)
+            grown[t] = array[t];
+        delete [] array;
+    }
+    array = grown;
+    return (true);
+}
+
+
+// reserve -- Make room for at least "num_rows" coded input vectors, keeping
+//            those already coded.  Return false on error.
+
+bool QuantizedInputs::reserve(int num_rows) {
+    if (num_rows <= n_allocated)
+        return (true);
+    if (!grow_array(codes, (size_t) num_rows * n_cols, (size_t) n_rows * n_cols) ||
+            !grow_array(lengths, num_rows, n_rows))
+        return (false);
+    n_allocated = num_rows;
+    return (true);
+}
+
+
+//
+// PatternSet Class  --  Member function implementations
+//
+
+// constructors
+
+PatternSet::PatternSet(int num_pat, int num_inputs, int num_targets) {
+    // no sort has been performed yet, and nothing is cached ...
+    distances = NULL;
+    norms = NULL;
+    unit_inputs_m = NULL;
+    float_inputs = NULL;
+    quantized = NULL;
+    // storage is allocated, rather than mapped from a file ...
+    mapped_data = NULL;
+    mapped_length = 0;
+    permutation = NULL;
+    inputs_m = NULL;
+    targets_m = NULL;
+    n_allocated = 0;
+    (void) allocate_storage(num_pat, num_inputs, num_targets);
 }
 
 PatternSet::PatternSet(const PatternSet& pset) {
     n_patterns = pset.n_patterns;
     n_inputs = pset.n_inputs;
     n_targets = pset.n_targets;
+    // distances are not copied, since they belong to the most recent sort,
+    // and caches are only built on request ...
+    distances = NULL;
+    norms = NULL;
+    unit_inputs_m = NULL;
+    float_inputs = NULL;
+    quantized = NULL;
+    // the copy always has storage of its own, even for a mapped file ...
+    mapped_data = NULL;
+    mapped_length = 0;
     // permutation sequence ...
     permute = pset.permute;
     permutation = NULL;
@@ -100,8 +276,39 @@ PatternSet::PatternSet(const PatternSet& pset) {
         n_inputs = -1;
         n_targets = -1;
     }
+    n_allocated = (n_patterns > 0) ? n_patterns : 0;
+}
+
+PatternSet::PatternSet(const PatternView& view) {
+    reset_empty();
+    if (view.number_of_patterns() < 0) {
+        // a view of nothing valid gives an invalid pattern set ...
+        n_patterns = -1;
+        n_inputs = -1;
+        n_targets = -1;
+        return;
+    }
+    if (!allocate_storage(view.number_of_patterns(), view.number_of_inputs(),
+                view.number_of_targets()))
+        return;
+    // copy the viewed vectors, row by row ...
+    for (int i = 0; i < n_patterns; i++) {
+        if (inputs_m)
+            memcpy(gsl_matrix_ptr(inputs_m, i, 0), view.input_row(i),
+                    n_inputs * sizeof(double));
+        if (targets_m)
+            memcpy(gsl_matrix_ptr(targets_m, i, 0), view.target_row(i),
+                    n_targets * sizeof(double));
+    }
 }
 
+#if __cplusplus >= 201103L
+PatternSet::PatternSet(PatternSet&& pset) {
+    reset_empty();
+    swap(pset);
+}
+#endif
+
 
 // assignment
 
@@ -110,15 +317,23 @@ PatternSet& PatternSet::operator=(const PatternSet& pset) {
 
     // Do nothing if we are assigning a pattern set to itself ...
     if (this != &pset) {
+        // storage with room to spare, or mapped from a file, is replaced by
+        // storage of exactly the right size ...
+        if ((n_allocated != n_patterns) || mapped_data) {
+            release_storage();
+            n_patterns = 0;
+        }
         old_n_patterns = n_patterns;
         n_patterns = pset.n_patterns;
         n_inputs = pset.n_inputs;
         n_targets = pset.n_targets;
         // copy input vector values, making sure sizes are appropriate ...
         if (pset.inputs_m != NULL) {
-            if ((inputs_m->size1 != pset.inputs_m->size1) ||
+            if ((inputs_m == NULL) ||
+                    (inputs_m->size1 != pset.inputs_m->size1) ||
                     (inputs_m->size2 != pset.inputs_m->size2)) {
-                gsl_matrix_free(inputs_m);
+                if (inputs_m)
+                    gsl_matrix_free(inputs_m);
                 inputs_m 
                     = gsl_matrix_alloc(pset.inputs_m->size1, pset.inputs_m->size2);
             }
@@ -131,9 +346,11 @@ PatternSet& PatternSet::operator=(const PatternSet& pset) {
         }
         // copy target vector values, making sure sizes are appropriate ...
         if (pset.targets_m != NULL) {
-            if ((targets_m->size1 != pset.targets_m->size1) ||
+            if ((targets_m == NULL) ||
+                    (targets_m->size1 != pset.targets_m->size1) ||
                     (targets_m->size2 != pset.targets_m->size2)) {
-                gsl_matrix_free(targets_m);
+                if (targets_m)
+                    gsl_matrix_free(targets_m);
                 targets_m 
                     = gsl_matrix_alloc(pset.targets_m->size1, pset.targets_m->size2);
             }
@@ -161,9 +378,73 @@ PatternSet& PatternSet::operator=(const PatternSet& pset) {
             }
         }
         permute = pset.permute;
+        // discard distances from any previous sort ...
+        if (distances) {
+            delete [] distances;
+            distances = NULL;
+        }
+        // discard caches describing the old input vectors ...
+        clear_caches();
+        n_allocated = (n_patterns > 0) ? n_patterns : 0;
+    }
+    return *this;
+}
+
+#if __cplusplus >= 201103L
+PatternSet& PatternSet::operator=(PatternSet&& pset) {
+    if (this != &pset) {
+        // free our own storage now, rather than when "pset" is destroyed ...
+        release_storage();
+        reset_empty();
+        swap(pset);
     }
     return *this;
 }
+#endif
+
+
+// swap -- Exchange the contents of this pattern set with those of the given
+//         one, without copying any vectors.
+
+void PatternSet::swap(PatternSet& pset) {
+    std::swap(n_patterns, pset.n_patterns);
+    std::swap(n_inputs, pset.n_inputs);
+    std::swap(n_targets, pset.n_targets);
+    std::swap(n_allocated, pset.n_allocated);
+    std::swap(inputs_m, pset.inputs_m);
+    std::swap(targets_m, pset.targets_m);
+    std::swap(permute, pset.permute);
+    std::swap(permutation, pset.permutation);
+    std::swap(distances, pset.distances);
+    std::swap(norms, pset.norms);
+    std::swap(unit_inputs_m, pset.unit_inputs_m);
+    std::swap(float_inputs, pset.float_inputs);
+    std::swap(quantized, pset.quantized);
+    std::swap(mapped_data, pset.mapped_data);
+    std::swap(mapped_length, pset.mapped_length);
+}
+
+
+// reset_empty -- Mark the pattern set as empty and owning nothing, without
+//                freeing anything that it referred to.
+
+void PatternSet::reset_empty() {
+    n_patterns = 0;
+    n_inputs = 0;
+    n_targets = 0;
+    n_allocated = 0;
+    inputs_m = NULL;
+    targets_m = NULL;
+    permute = false;
+    permutation = NULL;
+    distances = NULL;
+    norms = NULL;
+    unit_inputs_m = NULL;
+    float_inputs = NULL;
+    quantized = NULL;
+    mapped_data = NULL;
+    mapped_length = 0;
+}
 
 
 // destructor
@@ -173,6 +454,66 @@ PatternSet::~PatternSet() {
     n_inputs = -1;
     n_targets = -1;
     permute = false;
+    release_storage();
+}
+
+
+// allocate_storage -- Replace any existing vectors with freshly allocated
+//                     storage for the given numbers of patterns, inputs and
+//                     targets, resetting the permutation array.  The new
+//                     vectors are not initialized.  Return false, leaving
+//                     the pattern set invalid, on error.
+
+bool PatternSet::allocate_storage(int num_pat, int num_inputs,
+        int num_targets) {
+    release_storage();
+    n_patterns = num_pat;
+    n_inputs = num_inputs;
+    n_targets = num_targets;
+    // permutation sequence default values ...
+    if (n_patterns > 0) {
+        permute = true;
+        if (permutation = new int[n_patterns])
+            // initialize permutation sequence ...
+            for (int i = 0; i < n_patterns; i++)
+                permutation[i] = i;
+    } else {
+        permute = false;
+        permutation = NULL;
+    }
+    // allocate input vector storage ...
+    if ((n_patterns > 0) && (n_inputs > 0)) {
+        inputs_m = gsl_matrix_alloc(n_patterns, n_inputs);
+    } else {
+        inputs_m = NULL;
+    }
+    // allocate target vector storage ...
+    if ((n_patterns > 0) && (n_targets > 0)) {
+        targets_m = gsl_matrix_alloc(n_patterns, n_targets);
+    } else {
+        targets_m = NULL;
+    }
+    // check for allocation failure ...
+    if ((n_patterns > 0) &&
+            ((permutation == NULL) ||
+             ((n_inputs > 0) && (inputs_m == NULL)) ||
+             ((n_targets > 0) && (targets_m == NULL)))) {
+        // invalidate this pattern set ...
+        n_patterns = -1;
+        n_inputs = -1;
+        n_targets = -1;
+        return (false);
+    }
+    n_allocated = (n_patterns > 0) ? n_patterns : 0;
+    return (true);
+}
+
+
+// release_storage -- Deallocate the input and target vectors, the
+//                    permutation array, the distances and any caches, and
+//                    unmap any file that the vectors were read from.
+
+void PatternSet::release_storage() {
     // deallocate the input vectors ...
     if (inputs_m) {
         gsl_matrix_free(inputs_m);
@@ -188,6 +529,20 @@ PatternSet::~PatternSet() {
         delete [] permutation;
         permutation = NULL;
     }
+    // deallocate the distances from the most recent sort ...
+    if (distances) {
+        delete [] distances;
+        distances = NULL;
+    }
+    // deallocate the cached input vector lengths ...
+    clear_caches();
+    // release the mapped file only once nothing refers to it ...
+    if (mapped_data) {
+        (void) munmap(mapped_data, mapped_length);
+        mapped_data = NULL;
+        mapped_length = 0;
+    }
+    n_allocated = 0;
 }
 
 
@@ -256,6 +611,7 @@ int PatternSet::set_input_pattern(int i, gsl_vector* v) {
     if ((i >= 0) && (i < n_patterns) &&
             (v != NULL) && (v->size == n_inputs)) {
         (void) gsl_matrix_set_row(inputs_m, i, v);
+        update_cached_row(i);
         return (n_inputs);
     } else {
         return (-1);
@@ -295,6 +651,189 @@ int PatternSet::set_target_pattern(int i, gsl_vector* v) {
 }
 
 
+// smallest number of patterns that "append_pattern" makes room for
+static const int min_pattern_capacity = 16;
+
+
+// grow_matrix -- Move the first "used" rows of the given matrix into fresh
+//                storage for "rows" rows of "cols" values, leaving the
+//                matrix with "used" rows.  The matrix structure itself is
+//                kept, so that anything referring to it sees the new
+//                storage.  A NULL matrix is allocated.  Return false on
+//                error, leaving the matrix unchanged.
+
+static bool grow_matrix(gsl_matrix*& m, size_t rows, size_t used,
+        size_t cols) {
+    gsl_matrix* grown = gsl_matrix_alloc(rows, cols);
+
+    if (grown == NULL)
+        return (false);
+    if (m == NULL) {
+        m = grown;
+        m->size1 = used;
+        return (true);
+    }
+    for (size_t i = 0; i < used; i++)
+        memcpy(grown->data + i * grown->tda, m->data + i * m->tda,
+                cols * sizeof(double));
+    // exchange the contents of the two structures, so that freeing the
+    // spare one releases the old storage (or, for a matrix that does not own
+    // its elements, just the structure) ...
+    gsl_matrix old = *m;
+    *m = *grown;
+    *grown = old;
+    gsl_matrix_free(grown);
+    m->size1 = used;
+    return (true);
+}
+
+
+// reserve -- Make sure that the pattern set can hold at least the given
+//            number of patterns without its storage growing, copying
+//            vectors mapped from a file into storage of their own.  Return
+//            false on error.
+
+bool PatternSet::reserve(int num_pat) {
+    if ((n_patterns < 0) || (num_pat < 0))
+        return (false);
+    if (num_pat < n_allocated)
+        num_pat = n_allocated;
+    if ((num_pat == n_allocated) && (mapped_data == NULL))
+        return (true);
+    // grow every array holding a value or a vector for each pattern ...
+    if (((n_inputs > 0) &&
+                !grow_matrix(inputs_m, num_pat, n_patterns, n_inputs)) ||
+            ((n_targets > 0) &&
+             !grow_matrix(targets_m, num_pat, n_patterns, n_targets)) ||
+            (unit_inputs_m &&
+             !grow_matrix(unit_inputs_m, num_pat, n_patterns, n_inputs)) ||
+            !grow_array(permutation, num_pat, n_patterns) ||
+            (norms && !grow_array(norms, num_pat, n_patterns)) ||
+            (float_inputs && !grow_array(float_inputs,
+                    (size_t) num_pat * n_inputs,
+                    (size_t) n_patterns * n_inputs)) ||
+            (quantized && !quantized->reserve(num_pat)))
+        return (false);
+    // nothing refers to a mapped file any longer ...
+    if (mapped_data) {
+        (void) munmap(mapped_data, mapped_length);
+        mapped_data = NULL;
+        mapped_length = 0;
+    }
+    n_allocated = num_pat;
+    return (true);
+}
+
+
+// append_pattern -- Add a pattern with the given input and target vectors
+//                   to the end of the pattern set, doubling the storage when
+//                   it is full.  An empty pattern set with no inputs and no
+//                   targets takes the sizes of the given vectors.  Return
+//                   the index of the new pattern, or a negative value on
+//                   error.
+
+int PatternSet::append_pattern(gsl_vector* input_v, gsl_vector* target_v) {
+    if (n_patterns < 0)
+        return (-1);
+    if ((n_patterns == 0) && (n_inputs == 0) && (n_targets == 0) &&
+            (mapped_data == NULL)) {
+        int num_inputs = input_v ? (int) input_v->size : 0;
+        int num_targets = target_v ? (int) target_v->size : 0;
+        // storage already allocated for patterns of no size needs room
+        // for the vectors ...
+        if ((n_allocated > 0) &&
+                (((num_inputs > 0) &&
+                  !grow_matrix(inputs_m, n_allocated, 0, num_inputs)) ||
+                 ((num_targets > 0) &&
+                  !grow_matrix(targets_m, n_allocated, 0, num_targets))))
+            return (-1);
+        n_inputs = num_inputs;
+        n_targets = num_targets;
+    }
+    if (((input_v == NULL) ? (n_inputs > 0) : (input_v->size != n_inputs)) ||
+            ((target_v == NULL) ? (n_targets > 0) :
+             (target_v->size != n_targets)))
+        return (-1);
+    if ((n_patterns == n_allocated) || mapped_data) {
+        int num_pat = 2 * n_allocated;
+        if (num_pat < min_pattern_capacity)
+            num_pat = min_pattern_capacity;
+        if (!reserve(num_pat))
+            return (-1);
+    }
+    int i = n_patterns++;
+    if (inputs_m) {
+        inputs_m->size1 = n_patterns;
+        (void) gsl_matrix_set_row(inputs_m, i, input_v);
+    }
+    if (targets_m) {
+        targets_m->size1 = n_patterns;
+        (void) gsl_matrix_set_row(targets_m, i, target_v);
+    }
+    if (unit_inputs_m)
+        unit_inputs_m->size1 = n_patterns;
+    if (quantized)
+        quantized->n_rows = n_patterns;
+    permutation[i] = i;
+    if (i == 0)
+        permute = true;
+    // distances from the most recent sort no longer cover every pattern ...
+    if (distances) {
+        delete [] distances;
+        distances = NULL;
+    }
+    if (inputs_m)
+        update_cached_row(i);
+    return (i);
+}
+
+
+// erase_pattern -- Remove the "i"th pattern from the pattern set by moving
+//                  the last pattern into its place.  Return false on error.
+
+bool PatternSet::erase_pattern(int i) {
+    if ((i < 0) || (i >= n_patterns))
+        return (false);
+    int last = n_patterns - 1;
+    if (i != last) {
+        if (inputs_m)
+            memcpy(gsl_matrix_ptr(inputs_m, i, 0),
+                    gsl_matrix_const_ptr(inputs_m, last, 0),
+                    n_inputs * sizeof(double));
+        if (targets_m)
+            memcpy(gsl_matrix_ptr(targets_m, i, 0),
+                    gsl_matrix_const_ptr(targets_m, last, 0),
+                    n_targets * sizeof(double));
+    }
+    // the permutation loses the erased index, and the last index becomes
+    // the index of the pattern that was moved ...
+    int erased_t = 0;
+    for (int t = 0; t < n_patterns; t++)
+        if (permutation[t] == i)
+            erased_t = t;
+    permutation[erased_t] = permutation[last];
+    for (int t = 0; t < last; t++)
+        if (permutation[t] == last)
+            permutation[t] = i;
+    n_patterns = last;
+    if (inputs_m)
+        inputs_m->size1 = n_patterns;
+    if (targets_m)
+        targets_m->size1 = n_patterns;
+    if (unit_inputs_m)
+        unit_inputs_m->size1 = n_patterns;
+    if (quantized)
+        quantized->n_rows = n_patterns;
+    if (distances) {
+        delete [] distances;
+        distances = NULL;
+    }
+    if ((i != last) && inputs_m)
+        update_cached_row(i);
+    return (true);
+}
+
+
 // read -- Fill the pattern set from the contents of the given input
 //         stream, returning the stream, setting the appropriate error
 //         bits on the stream when an error occurs.
@@ -302,6 +841,8 @@ int PatternSet::set_target_pattern(int i, gsl_vector* v) {
 istream& operator>>(istream& istr, PatternSet& pset) {
     double value;  // temporary buffer
 
+    // any cached input vector lengths are about to become stale ...
+    pset.clear_caches();
     if (pset.inputs_m || pset.targets_m) {
         // Note that testing "istr" is the same as checking the "failbit" ...
         for (int i = 0; (i < pset.n_patterns) && istr; i++) {
@@ -327,24 +868,29 @@ ostream& operator<<(ostream& ostr, const PatternSet& pset) {
     int pat_i;     // real pattern index
 
     if (pset.inputs_m || pset.targets_m) {
-        // Note that testing "ostr" is the same as checking the "failbit" ...
-        for (int i = 0; (i < pset.n_patterns) && ostr; i++) {
+        // Format whole rows into a large buffer rather than the stream ...
+        FormattedWriter out(ostr);
+        for (int i = 0; (i < pset.n_patterns) && out.good(); i++) {
             if (pset.permute) {
                 pat_i = pset.get_permuted_i(i);
             } else {
                 pat_i = i;
             }
-            for (int j_in = 0; (j_in < pset.n_inputs) && ostr; j_in++) {
-                ostr << " " << setw(14) << fixed << setprecision(8) 
-                    <<	gsl_matrix_get(pset.inputs_m, pat_i, j_in);
+            for (int j_in = 0; j_in < pset.n_inputs; j_in++) {
+                out.put(' ');
+                out.put_fixed(gsl_matrix_get(pset.inputs_m, pat_i, j_in),
+                        14, 8);
             }
-            for (int j_targ = 0; (j_targ < pset.n_targets) && ostr; j_targ++) {
-                ostr << " " << setw(14) << fixed << setprecision(8) 
-                    <<	gsl_matrix_get(pset.targets_m, pat_i, j_targ);
+            for (int j_targ = 0; j_targ < pset.n_targets; j_targ++) {
+                out.put(' ');
+                out.put_fixed(gsl_matrix_get(pset.targets_m, pat_i, j_targ),
+                        14, 8);
             }
-            ostr << endl;
+            out.put('\n');
         }
+        (void) out.flush();
     }
+    ostr.flush();
     return (ostr);
 }
 
@@ -392,39 +938,313 @@ bool PatternSet::permute_patterns() {
 }
 
 
+// contiguous_data -- Return a pointer to the elements of the given vector
+//                    as a contiguous array, copying them into "buffer" only
+//                    if the vector is strided.
+
+static const double* contiguous_data(const gsl_vector* v, vector<double>& buffer) {
+    if (v->stride == 1)
+        return (v->data);
+    buffer.resize(v->size);
+    for (size_t j = 0; j < v->size; j++)
+        buffer[j] = gsl_vector_get(v, j);
+    return (&buffer[0]);
+}
+
+
+// euclidean_distances -- Fill the given array with the Euclidean distance
+//                        of every input vector from the given reference
+//                        vector.  Return false on error.
+
+bool PatternSet::euclidean_distances(gsl_vector* ref_v, double* dist) const {
+    if ((n_patterns > 0) && inputs_m && dist &&
+            ref_v && (ref_v->size == n_inputs)) {
+        vector<double> ref_buffer;
+        const double* ref = contiguous_data(ref_v, ref_buffer);
+        if (quantized) {
+            // express the reference vector in the units of the codes, so
+            // that the coded rows are compared without decoding them ...
+            vector<double> point(n_inputs);
+            vector<double> weights(n_inputs);
+            double fixed_part = 0.0;
+            for (int j = 0; j < n_inputs; j++) {
+                double step = quantized->scale[j];
+                if (step > 0.0) {
+                    point[j] = (ref[j] - quantized->offset[j]) / step;
+                    weights[j] = step * step;
+                } else {
+                    // constant columns add the same amount to every row ...
+                    double diff = quantized->offset[j] - ref[j];
+                    fixed_part += diff * diff;
+                    point[j] = 0.0;
+                    weights[j] = 0.0;
+                }
+            }
+            for (int i = 0; i < n_patterns; i++)
+                dist[i] = sqrt(fixed_part + weighted_squared_distance(
+                            quantized->row(i), &point[0], &weights[0],
+                            n_inputs));
+            return (true);
+        }
+        if (float_inputs) {
+            // scan the single-precision copy, which is half the size ...
+            for (int i = 0; i < n_patterns; i++)
+                dist[i] = sqrt(squared_distance(
+                            float_inputs + (size_t) i * n_inputs, ref,
+                            n_inputs));
+            return (true);
+        }
+        // compare each row of the input matrix in place ...
+        for (int i = 0; i < n_patterns; i++)
+            dist[i] = sqrt(squared_distance(gsl_matrix_const_ptr(inputs_m, i, 0),
+                        ref, n_inputs));
+        return (true);
+    } else {
+        return (false);
+    }
+}
+
+
+// angular_similarities -- Fill the given array with the inner product of
+//                         every input vector with the given reference
+//                         vector, divided by the length of the input vector.
+//                         Cached unit length input vectors reduce this to a
+//                         single matrix-vector product, and cached lengths
+//                         to one inner product per pattern.  Cached byte
+//                         coded or single-precision input vectors are
+//                         scanned in place of the input matrix.  Return
+//                         false on error.
+
+bool PatternSet::angular_similarities(gsl_vector* ref_v, double* sim) const {
+    double inner_product;
+    double pattern_vector_length;
+
+    if ((n_patterns > 0) && inputs_m && sim &&
+            ref_v && (ref_v->size == n_inputs)) {
+        if (unit_inputs_m && !quantized) {
+            // Zero length vectors were left as zero vectors, making them
+            // orthogonal to all reference vectors ...
+            gsl_vector_view sim_v_view = gsl_vector_view_array(sim, n_patterns);
+            (void) gsl_blas_dgemv(CblasNoTrans, 1.0, unit_inputs_m, ref_v,
+                    0.0, &sim_v_view.vector);
+            return (true);
+        }
+        vector<double> ref_buffer;
+        const double* ref = contiguous_data(ref_v, ref_buffer);
+        if (quantized) {
+            // the inner product of a decoded row with the reference vector
+            // is a fixed part plus that of the codes with scaled weights ...
+            vector<double> weights(n_inputs);
+            double fixed_part = 0.0;
+            for (int j = 0; j < n_inputs; j++) {
+                weights[j] = quantized->scale[j] * ref[j];
+                fixed_part += quantized->offset[j] * ref[j];
+            }
+            for (int i = 0; i < n_patterns; i++) {
+                inner_product = fixed_part +
+                    dot_product(quantized->row(i), &weights[0], n_inputs);
+                pattern_vector_length = quantized->lengths[i];
+                sim[i] = (pattern_vector_length > 0) ?
+                    (inner_product / pattern_vector_length) : 0.0;
+            }
+            return (true);
+        }
+        for (int i = 0; i < n_patterns; i++) {
+            const double* pat = gsl_matrix_const_ptr(inputs_m, i, 0);
+            if (float_inputs) {
+                inner_product = dot_and_norm(
+                        float_inputs + (size_t) i * n_inputs, ref, n_inputs,
+                        &pattern_vector_length);
+                pattern_vector_length = norms ? norms[i] :
+                    sqrt(pattern_vector_length);
+            } else if (norms) {
+                inner_product = dot_product(pat, ref, n_inputs);
+                pattern_vector_length = norms[i];
+            } else {
+                inner_product = dot_and_norm(pat, ref, n_inputs,
+                        &pattern_vector_length);
+                pattern_vector_length = sqrt(pattern_vector_length);
+            }
+            if (pattern_vector_length > 0) {
+                // Note that we don't bother to divide by the length of the 
+                // reference vector, since it is the same length for every
+                // pattern ...
+                sim[i] = inner_product / pattern_vector_length;
+            } else {
+                // Zero length vectors are taken as orthogonal to all reference
+                // vectors ...
+                sim[i] = 0.0;
+            }
+        }
+        return (true);
+    } else {
+        return (false);
+    }
+}
+
+
+// update_cached_row -- Bring the cached length, unit length copy,
+//                      single-precision copy and byte coded copy of the "i"th
+//                      input vector up to date, for whichever of the caches
+//                      exist.  The byte coded copy is discarded if the vector
+//                      no longer fits its column ranges.
+
+void PatternSet::update_cached_row(int i) {
+    const double* pat = gsl_matrix_const_ptr(inputs_m, i, 0);
+    double length = sqrt(dot_product(pat, pat, n_inputs));
+
+    if (norms)
+        norms[i] = length;
+    if (unit_inputs_m) {
+        double* unit = gsl_matrix_ptr(unit_inputs_m, i, 0);
+        for (int j = 0; j < n_inputs; j++)
+            unit[j] = (length > 0) ? (pat[j] / length) : 0.0;
+    }
+    if (float_inputs) {
+        float* compact = float_inputs + (size_t) i * n_inputs;
+        for (int j = 0; j < n_inputs; j++)
+            compact[j] = (float) pat[j];
+    }
+    if (quantized && !quantized->encode_row(i, pat)) {
+        delete quantized;
+        quantized = NULL;
+    }
+}
+
+
+// cache_norms -- Compute and keep the length of every input vector, so
+//                that angular queries need not recompute them.  Return
+//                false on error.
+
+bool PatternSet::cache_norms() {
+    if ((n_patterns > 0) && inputs_m) {
+        // room for every pattern the storage holds, so that appending
+        // a pattern can extend the cache ...
+        if (norms == NULL)
+            norms = new double[n_allocated];
+        if (norms == NULL)
+            return (false);
+        for (int i = 0; i < n_patterns; i++)
+            update_cached_row(i);
+        return (true);
+    } else {
+        return (false);
+    }
+}
+
+
+// cache_unit_inputs -- Compute and keep a copy of the input vectors scaled
+//                      to unit length, so that the angular similarities for
+//                      a query take a single matrix-vector product.  Return
+//                      false on error.
+
+bool PatternSet::cache_unit_inputs() {
+    if ((n_patterns > 0) && inputs_m) {
+        if (unit_inputs_m == NULL) {
+            unit_inputs_m = gsl_matrix_alloc(n_allocated, n_inputs);
+            if (unit_inputs_m == NULL)
+                return (false);
+            unit_inputs_m->size1 = n_patterns;
+        }
+        for (int i = 0; i < n_patterns; i++)
+            update_cached_row(i);
+        return (true);
+    } else {
+        return (false);
+    }
+}
+
+
+// cache_float_inputs -- Compute and keep a single-precision copy of the
+//                       input vectors, for Euclidean and angular queries to
+//                       scan in place of the input matrix.  Return false on
+//                       error.
+
+bool PatternSet::cache_float_inputs() {
+    if ((n_patterns > 0) && inputs_m) {
+        if (float_inputs == NULL)
+            float_inputs = new float[(size_t) n_allocated * n_inputs];
+        if (float_inputs == NULL)
+            return (false);
+        for (int i = 0; i < n_patterns; i++)
+            update_cached_row(i);
+        return (true);
+    } else {
+        return (false);
+    }
+}
+
+
+// cache_quantized_inputs -- Compute and keep a copy of the input vectors
+//                           with every value coded in a single byte, for
+//                           Euclidean and angular queries to compare against
+//                           directly.  Return false on error.
+
+bool PatternSet::cache_quantized_inputs() {
+    if ((n_patterns > 0) && (n_inputs > 0) && inputs_m) {
+        if (quantized)
+            delete quantized;
+        quantized = new QuantizedInputs(inputs_m, n_allocated);
+        if (quantized && quantized->codes && quantized->offset &&
+                quantized->scale && quantized->lengths)
+            return (true);
+        if (quantized)
+            delete quantized;
+        quantized = NULL;
+        return (false);
+    } else {
+        return (false);
+    }
+}
+
+
+// clear_caches -- Discard the cached lengths and the unit length,
+//                 single-precision and byte coded copies of the input
+//                 vectors.
+
+void PatternSet::clear_caches() {
+    if (norms) {
+        delete [] norms;
+        norms = NULL;
+    }
+    if (unit_inputs_m) {
+        gsl_matrix_free(unit_inputs_m);
+        unit_inputs_m = NULL;
+    }
+    if (float_inputs) {
+        delete [] float_inputs;
+        float_inputs = NULL;
+    }
+    if (quantized) {
+        delete quantized;
+        quantized = NULL;
+    }
+}
+
+
 // sort_euclidean -- Fill the permutation array so as to sort the input
 //                   vectors in order of increasing Euclidean distance from
 //                   the given reference vector.  Return false on error.
 
 bool PatternSet::sort_euclidean(gsl_vector* ref_v) {
     if (permutation) {
-        if(distances)
-            delete[] distances;
-        distances = new double[n_patterns];
+        // the distances array always holds "n_patterns" values, so it may be
+        // reused from one query to the next ...
+        if (distances == NULL)
+            distances = new double[n_patterns];
         size_t* perm = new size_t[n_patterns];
-        gsl_vector* diff_v = gsl_vector_alloc(n_inputs);
 
-        if (distances && perm && diff_v) {
-            for (int i = 0; i < n_patterns; i++) {
-                (void) gsl_matrix_get_row(diff_v, inputs_m, i);
-                (void) gsl_vector_sub(diff_v, ref_v);
-                distances[i] = gsl_blas_dnrm2(diff_v);
-            }
+        if (perm && euclidean_distances(ref_v, distances)) {
             (void) gsl_sort_index(perm, distances, 1, n_patterns);
             for (int i = 0; i < n_patterns; i++)
                 permutation[i] = (int) perm[i];
             // deallocate storage ...
             delete [] perm;
-            gsl_vector_free(diff_v);
             // return success ...
             return (true);
         } else {
-            if (distances)
-                delete [] distances;
             if (perm)
                 delete [] perm;
-            if (diff_v)
-                gsl_vector_free(diff_v);
             // return failure due to allocation problems ...
             return (false);
         }
@@ -435,35 +1255,110 @@ bool PatternSet::sort_euclidean(gsl_vector* ref_v) {
 }
 
 
+// DistanceOrder -- A comparison object that orders pattern indices by
+//                  increasing distance, breaking ties by index so that
+//                  the selected neighbors do not depend on the current
+//                  contents of the permutation array.
+
+struct DistanceOrder {
+    const double* distances;
+
+    DistanceOrder(const double* d) : distances(d) {}
+
+    bool operator()(int a, int b) const {
+        return ((distances[a] < distances[b]) ||
+                ((distances[a] == distances[b]) && (a < b)));
+    }
+};
+
+
+// SimilarityOrder -- A comparison object that orders pattern indices by
+//                    decreasing similarity, breaking ties by index.
+
+struct SimilarityOrder {
+    const double* similarities;
+
+    SimilarityOrder(const double* s) : similarities(s) {}
+
+    bool operator()(int a, int b) const {
+        return ((similarities[a] > similarities[b]) ||
+                ((similarities[a] == similarities[b]) && (a < b)));
+    }
+};
+
+
+// select_k_nearest -- Rearrange the permutation array so that its first
+//                     "k" entries hold the indices of the "k" input vectors
+//                     closest, in Euclidean distance, to the given reference
+//                     vector, in order of increasing distance.  The order of
+//                     the remaining entries is unspecified.  Only those "k"
+//                     patterns are sorted, rather than the whole set.  Return
+//                     false on error.
+
+bool PatternSet::select_k_nearest(gsl_vector* ref_v, int k) {
+    if (permutation && (k > 0)) {
+        if (k > n_patterns)
+            k = n_patterns;
+        if (distances == NULL)
+            distances = new double[n_patterns];
+        if (distances && euclidean_distances(ref_v, distances)) {
+            // "partial_sort" keeps a bounded heap of the "k" best candidates,
+            // costing O(n log k) rather than the O(n log n) of a full sort ...
+            std::partial_sort(permutation, permutation + k,
+                    permutation + n_patterns, DistanceOrder(distances));
+            return (true);
+        } else {
+            return (false);
+        }
+    } else {
+        // return failure ...
+        return (false);
+    }
+}
+
+
+// nearest_euclidean -- Find the "k" input vectors closest, in Euclidean
+//                      distance, to the given reference vector, writing
+//                      their indices to "nearest_i" and their distances to
+//                      "nearest_d", in order of increasing distance.  All
+//                      intermediate results are kept in the given
+//                      workspace, so the pattern set is left unchanged.
+//                      Return the number of neighbors found, or a negative
+//                      value on error.
+
+int PatternSet::nearest_euclidean(gsl_vector* ref_v, int k, int* nearest_i,
+        double* nearest_d, QueryWorkspace& ws) const {
+    if ((k <= 0) || (nearest_i == NULL) || (nearest_d == NULL) ||
+            !ws.reserve(n_patterns) || !euclidean_distances(ref_v, ws.distances))
+        return (-1);
+    if (k > n_patterns)
+        k = n_patterns;
+    for (int i = 0; i < n_patterns; i++)
+        ws.order[i] = i;
+    std::partial_sort(ws.order, ws.order + k, ws.order + n_patterns,
+            DistanceOrder(ws.distances));
+    for (int t = 0; t < k; t++) {
+        nearest_i[t] = ws.order[t];
+        nearest_d[t] = ws.distances[ws.order[t]];
+    }
+    return (k);
+}
+
+
 // sort_angular -- Fill the permutation array so as to sort the input
 //                 vectors in order of increasing angular distance from
 //                 the given reference vector.  Return false on error.
 
 bool PatternSet::sort_angular(gsl_vector* ref_v) {
     if (permutation) {
-        if(distances)
-            delete[] distances;
-        distances = new double[n_patterns];
+        if (distances == NULL)
+            distances = new double[n_patterns];
+        // the input vector lengths are the same for every query ...
+        if (norms == NULL)
+            (void) cache_norms();
         size_t* perm = new size_t[n_patterns];
-        double dot_product;
-        double pattern_vector_length;
 
-        if (distances && perm) {
-            for (int i = 0; i < n_patterns; i++) {
-                gsl_vector_view pat_v_view = gsl_matrix_row(inputs_m, i);
-                (void) gsl_blas_ddot(&pat_v_view.vector, ref_v, &dot_product);
-                pattern_vector_length = gsl_blas_dnrm2(&pat_v_view.vector);
-                if (pattern_vector_length > 0) {
-                    // Note that we don't bother to divide by the length of the 
-                    // reference vector, since it is the same length for every
-                    // pattern ...
-                    distances[i] = dot_product / pattern_vector_length;
-                } else {
-                    // Zero length vectors are taken as orthogonal to all reference
-                    // vectors ...
-                    distances[i] = 0.0;
-                }
-            }
+        if (perm && angular_similarities(ref_v, distances)) {
             (void) gsl_sort_index(perm, distances, 1, n_patterns);
             // The "perm" array is now sorted in increasing order of *inner product*,
             // which is exactly the opposite of the order we want.  (Large inner
@@ -476,8 +1371,6 @@ bool PatternSet::sort_angular(gsl_vector* ref_v) {
             // return success ...
             return (true);
         } else {
-            if (distances)
-                delete [] distances;
             if (perm)
                 delete [] perm;
             // return failure due to allocation problems ...
@@ -490,46 +1383,91 @@ bool PatternSet::sort_angular(gsl_vector* ref_v) {
 }
 
 
-// covariance_matrix -- This utility function returns the covariance
-//                      matrix associated with the given matrix of
-//                      pattern vectors.  Storage for the matrix is
-//                      passed in as the first argument.  The mean of
-//                      each data feature is passed in as a vector.
-//                      Return NULL on error.
-
-gsl_matrix* covariance_matrix(gsl_matrix* cov_m, gsl_matrix* data_m, 
-        gsl_vector* means_v) {
-    int n;             // number of data vectors
-    int d;             // dimensionality of data space
-    double cov_value;  // a single entry in the covariance matrix
-
-    if (cov_m && data_m) {
-        n = data_m->size1;
-        d = data_m->size2;
-        if ((n > 0) && (d > 0) && (d == cov_m->size1) && (d == cov_m->size2)) {
-            for (int j1 = 0; j1 < d; j1++)
-                for (int j2 = 0; j2 <= j1; j2++) {
-                    // calculate the covariance between data dimension "j1" and
-                    // data dimension "j2" ...
-                    gsl_vector_view col1_v_view = gsl_matrix_column(data_m, j1);
-                    gsl_vector_view col2_v_view = gsl_matrix_column(data_m, j2);
-                    cov_value = gsl_stats_covariance_m(col1_v_view.vector.data,
-                            col1_v_view.vector.stride,
-                            col2_v_view.vector.data,
-                            col2_v_view.vector.stride,
-                            n,
-                            gsl_vector_get(means_v, j1),
-                            gsl_vector_get(means_v, j2));
-                    gsl_matrix_set(cov_m, j1, j2, cov_value);
-                    gsl_matrix_set(cov_m, j2, j1, cov_value);
-                }
-            return (cov_m);
-        } else {
-            return (NULL);
-        }
-    } else {
-        return (NULL);
+// nearest_angular -- Find the "k" input vectors closest, in angular
+//                    distance, to the given reference vector, writing their
+//                    indices to "nearest_i" and, as "sort_angular" records
+//                    in the distances array, their inner products with the
+//                    reference vector over their own lengths to "nearest_d".
+//                    All intermediate results are kept in the given
+//                    workspace, so the pattern set is left unchanged.
+//                    Return the number of neighbors found, or a negative
+//                    value on error.
+
+int PatternSet::nearest_angular(gsl_vector* ref_v, int k, int* nearest_i,
+        double* nearest_d, QueryWorkspace& ws) const {
+    if ((k <= 0) || (nearest_i == NULL) || (nearest_d == NULL) ||
+            !ws.reserve(n_patterns) || !angular_similarities(ref_v, ws.distances))
+        return (-1);
+    if (k > n_patterns)
+        k = n_patterns;
+    for (int i = 0; i < n_patterns; i++)
+        ws.order[i] = i;
+    std::partial_sort(ws.order, ws.order + k, ws.order + n_patterns,
+            SimilarityOrder(ws.distances));
+    for (int t = 0; t < k; t++) {
+        nearest_i[t] = ws.order[t];
+        nearest_d[t] = ws.distances[ws.order[t]];
     }
+    return (k);
+}
+
+
+// view -- Return a view of the patterns with indices from "begin" up to,
+//         but not including, "end", or of every pattern.
+
+PatternView PatternSet::view(int begin, int end) const {
+    return (PatternView(*this, begin, end));
+}
+
+PatternView PatternSet::view() const {
+    return (PatternView(*this, 0, (n_patterns > 0) ? n_patterns : 0));
+}
+
+
+// pca_project_into -- Fill the given pattern set with the input vectors of
+//                     this one projected onto the principal component axes
+//                     of the given model, along with copies of the target
+//                     vectors and the permutation sequence.  Return false
+//                     on error.
+
+bool PatternSet::pca_project_into(PatternSet& projected,
+        const PCAModel& model) const {
+    if ((n_patterns <= 0) || (n_inputs <= 0) ||
+            (model.number_of_inputs() != n_inputs) ||
+            (model.number_of_components() <= 0) ||
+            !projected.allocate_storage(n_patterns,
+                model.number_of_components(), n_targets))
+        return (false);
+    // the targets and permutation sequence are carried over unchanged ...
+    if (targets_m)
+        (void) gsl_matrix_memcpy(projected.targets_m, targets_m);
+    if (permutation)
+        for (int i = 0; i < n_patterns; i++)
+            projected.permutation[i] = permutation[i];
+    projected.permute = permute;
+    // project the input vectors straight into the new set ...
+    return (model.transform(inputs_m, projected.inputs_m));
+}
+
+
+// pca_projection -- Return a pattern set holding the input vectors of this
+//                   one projected onto their leading principal component
+//                   axes, or onto those of the given model.  Return an
+//                   empty pattern set on error.
+
+PatternSet PatternSet::pca_projection(int n_components,
+        double variance_fraction, int n_workers) const {
+    PCAModel model(*this, n_components, variance_fraction, n_workers);
+
+    return (pca_projection(model));
+}
+
+PatternSet PatternSet::pca_projection(const PCAModel& model) const {
+    PatternSet projected;
+
+    if (!pca_project_into(projected, model))
+        (void) projected.allocate_storage(0, 0, 0);
+    return (projected);
 }
 
 
@@ -538,68 +1476,118 @@ gsl_matrix* covariance_matrix(gsl_matrix* cov_m, gsl_matrix* data_m,
 //                The copy should be freshly allocated.  Return the
 //                original pattern set on error.
 
-PatternSet& PatternSet::pca_project() {
-    if ((n_patterns > 0) && (n_inputs > 0)) {
-        // compute the vector element means ...
-        gsl_vector* means_v = gsl_vector_alloc(n_inputs);
-        for (int j = 0; j < n_inputs; j++) {
-            gsl_vector_view col_v_view = gsl_matrix_column(inputs_m, j);
-            gsl_vector_set(means_v, j, 
-                    gsl_stats_mean(col_v_view.vector.data, 
-                        col_v_view.vector.stride, n_patterns));
-        }
-        // compute the covariance matrix ...
-        gsl_matrix* cov_m = gsl_matrix_alloc(n_inputs, n_inputs);
-        cov_m = covariance_matrix(cov_m, inputs_m, means_v);
-        // compute the eigenvectors of the covariance matrix ...
-        gsl_eigen_symmv_workspace* ws = gsl_eigen_symmv_alloc(n_inputs);
-        gsl_vector* eigenvalues = gsl_vector_alloc(n_inputs);
-        gsl_matrix* eigenvectors = gsl_matrix_alloc(n_inputs, n_inputs);
-        (void) gsl_eigen_symmv(cov_m, eigenvalues, eigenvectors, ws);
-        // sort the eigenvalues from low to high (reverse order) ...
-        size_t* eval_perm = new size_t[n_inputs];
-        (void) gsl_sort_index(eval_perm, eigenvalues->data, 
-                eigenvalues->stride, n_inputs);
-        // make a copy of the pattern set, using the copy constructor ...
-        PatternSet* new_pset = new PatternSet(*this);
-        // allocate storage for an orginal pattern vector and the corresponding
-        // projected vector ...
-        gsl_vector* pat_v = gsl_vector_alloc(n_inputs);
-        double projected_value;
-        gsl_vector* projected_v = gsl_vector_alloc(n_inputs);
-        // iterate over the input vectors ...
-        for (int pat_i = 0; pat_i < n_patterns; pat_i++) {
-            // extract the pattern input vector ...
-            (void) gsl_matrix_get_row(pat_v, inputs_m, pat_i);
-            // offset pattern vector by the distribution mean ...
-            (void) gsl_vector_sub(pat_v, means_v);
-            // iterate over the eigenvectors, in order ...
-            for (int eval_i = 0; eval_i < n_inputs; eval_i++) {
-                // find the "i"th principal component, noting that "eval_perm" is
-                // sorted from low eigenvalues to high eigenvalues (reverse order) ...
-                int pca_i = eval_perm[n_inputs - eval_i - 1];
-                gsl_vector_view pca_i_v_view = gsl_matrix_column(eigenvectors, pca_i);
-                // project this input vector onto the "i"th principal component ...
-                (void) gsl_blas_ddot(pat_v, &pca_i_v_view.vector, &projected_value);
-                // record the projected coordinate ...
-                gsl_vector_set(projected_v, eval_i, projected_value);
-            }
-            // record the projected vector into the new pattern set ...
-            (void) new_pset->set_input_pattern(pat_i, projected_v);
-        }
-        // deallocate storage ...
-        gsl_vector_free(means_v);
-        gsl_matrix_free(cov_m);
-        gsl_eigen_symmv_free(ws);
-        gsl_vector_free(eigenvalues);
-        gsl_matrix_free(eigenvectors);
-        delete [] eval_perm;
-        gsl_vector_free(pat_v);
-        gsl_vector_free(projected_v);
-        // return new pattern set ...
-        return (*new_pset);
-    } else {
+PatternSet& PatternSet::pca_project(int n_workers) {
+    PCAModel model(*this, 0, 1.0, n_workers);
+    PatternSet* new_pset = new PatternSet();
+
+    if (!pca_project_into(*new_pset, model)) {
+        delete new_pset;
         return (*this);
     }
+    // return new pattern set ...
+    return (*new_pset);
+}
+
+
+//
+// PatternView Class  --  Member function implementations
+//
+
+// empty_matrix_view -- Return a view of no matrix elements at all.
+static gsl_matrix_const_view empty_matrix_view() {
+    gsl_matrix_const_view view;
+
+    memset(&view, 0, sizeof(view));
+    return (view);
+}
+
+// constructors
+
+PatternView::PatternView() {
+    n_patterns = 0;
+    n_inputs = 0;
+    n_targets = 0;
+    first = 0;
+    inputs_view = empty_matrix_view();
+    targets_view = empty_matrix_view();
+}
+
+PatternView::PatternView(const PatternSet& pset, int begin, int end) {
+    n_inputs = pset.number_of_inputs();
+    n_targets = pset.number_of_targets();
+    inputs_view = empty_matrix_view();
+    targets_view = empty_matrix_view();
+    if ((begin < 0) || (end < begin) || (end > pset.number_of_patterns())) {
+        n_patterns = -1;
+        first = 0;
+        return;
+    }
+    n_patterns = end - begin;
+    first = begin;
+    // GSL does not allow views of no rows ...
+    if (n_patterns == 0)
+        return;
+    if ((n_inputs > 0) && pset.input_matrix())
+        inputs_view = gsl_matrix_const_submatrix(pset.input_matrix(),
+                begin, 0, n_patterns, n_inputs);
+    if ((n_targets > 0) && pset.target_matrix())
+        targets_view = gsl_matrix_const_submatrix(pset.target_matrix(),
+                begin, 0, n_patterns, n_targets);
+}
+
+
+// input_pattern -- Copy the input vector for the "i"th pattern in the view
+//                  into the given vector, returning a pointer to it.  Return
+//                  NULL on error.
+
+gsl_vector* PatternView::input_pattern(int i, gsl_vector* v) const {
+    if ((i >= 0) && (i < n_patterns) && (n_inputs > 0) &&
+            (v != NULL) && (v->size == n_inputs)) {
+        (void) gsl_matrix_get_row(v, &inputs_view.matrix, i);
+        return (v);
+    } else {
+        return (NULL);
+    }
+}
+
+
+// target_pattern -- Copy the target vector for the "i"th pattern in the
+//                   view into the given vector, returning a pointer to it.
+//                   Return NULL on error.
+
+gsl_vector* PatternView::target_pattern(int i, gsl_vector* v) const {
+    if ((i >= 0) && (i < n_patterns) && (n_targets > 0) &&
+            (v != NULL) && (v->size == n_targets)) {
+        (void) gsl_matrix_get_row(v, &targets_view.matrix, i);
+        return (v);
+    } else {
+        return (NULL);
+    }
+}
+
+
+// subview -- Return a view of the patterns of this view with indices from
+//            "begin" up to, but not including, "end".
+
+PatternView PatternView::subview(int begin, int end) const {
+    PatternView sub;
+
+    sub.n_inputs = n_inputs;
+    sub.n_targets = n_targets;
+    if ((begin < 0) || (end < begin) || (end > n_patterns)) {
+        sub.n_patterns = -1;
+        return (sub);
+    }
+    sub.n_patterns = end - begin;
+    sub.first = first + begin;
+    if (sub.n_patterns == 0)
+        return (sub);
+    if (input_matrix())
+        sub.inputs_view = gsl_matrix_const_submatrix(&inputs_view.matrix,
+                begin, 0, sub.n_patterns, n_inputs);
+    if (target_matrix())
+        sub.targets_view = gsl_matrix_const_submatrix(&targets_view.matrix,
+                begin, 0, sub.n_patterns, n_targets);
+    return (sub);
 }
 
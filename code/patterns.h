@@ -11,6 +11,7 @@
 
 
 #include <iostream>
+#include <vector>
 
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_matrix.h>
@@ -19,8 +20,116 @@
 using namespace std;
 
 
-// Forward declaration ...
+// Forward declarations ...
 class PatternSet;
+class PatternView;
+class PCAModel;
+
+
+// DistanceMetric -- The measures of distance between input vectors that
+//                   nearest neighbor queries understand.
+enum DistanceMetric { EUCLIDEAN_METRIC, ANGULAR_METRIC };
+
+
+//
+// QueryWorkspace Class  --  Scratch storage for nearest neighbor queries
+//                           against a pattern set.  Each thread querying a
+//                           shared pattern set should use its own
+//                           workspace, since the pattern set itself is not
+//                           written by such queries.
+//
+
+class QueryWorkspace {
+
+    private:
+
+        // workspaces are not copyable ...
+        QueryWorkspace(const QueryWorkspace&);
+        QueryWorkspace& operator=(const QueryWorkspace&);
+
+    public:
+
+        int size;                 // number of patterns that fit
+        int* order;               // pattern indices, partially sorted
+        double* distances;        // distance of each pattern from the query
+
+        unsigned visit_epoch;     // tag of the current graph search
+        vector<unsigned> visit_tags;  // tag of the graph search that last
+                                      // visited each pattern
+
+        QueryWorkspace(int num_pat = 0);
+        ~QueryWorkspace();
+
+        // reserve -- Make sure that the workspace can hold at least the given
+        //            number of patterns.  Return false on error.
+        bool reserve(int num_pat);
+
+        // begin_visits -- Start a graph search over "num_pat" patterns, none
+        //                 of which has been visited yet.  Only the tag of
+        //                 the current search changes, so this takes
+        //                 constant time, except when the tags first grow or
+        //                 the tag wraps around.
+        void begin_visits(int num_pat);
+
+        // visit -- Mark the "i"th pattern as visited by the current graph
+        //          search, returning false if it already was.
+        inline bool visit(int i) {
+            if (visit_tags[i] == visit_epoch)
+                return (false);
+            visit_tags[i] = visit_epoch;
+            return (true);
+        }
+
+};
+
+
+//
+// QuantizedInputs Class  --  A compact copy of the input vectors of a
+//                            pattern set, with every value stored as a
+//                            byte code.  Column "j" decodes as
+//                            "offset[j] + scale[j] * code", with the offset
+//                            and scale chosen from the range of values in
+//                            that column.  Columns of small integers, such
+//                            as counts or ratings, are coded exactly.
+//
+
+class QuantizedInputs {
+
+    private:
+
+        // quantized copies are not copyable ...
+        QuantizedInputs(const QuantizedInputs&);
+        QuantizedInputs& operator=(const QuantizedInputs&);
+
+    public:
+
+        int n_rows;               // number of input vectors coded
+        int n_allocated;          // number of input vectors that fit
+        int n_cols;               // number of values in each input vector
+        unsigned char* codes;     // the coded input vectors, one per row
+        double* offset;           // value of a zero code in each column
+        double* scale;            // value of one code step in each column
+        double* lengths;          // length of each decoded input vector
+
+        // Code the rows of the given matrix, leaving room for at least
+        // "capacity" rows in all.
+        QuantizedInputs(const gsl_matrix* inputs_m, int capacity = 0);
+        ~QuantizedInputs();
+
+        // row -- Return a pointer to the codes for the "i"th input vector.
+        inline const unsigned char* row(int i) const
+            { return (codes + (size_t) i * n_cols); }
+
+        // encode_row -- Code the given input vector as the "i"th row.
+        //               Return false if any of its values lie outside the
+        //               range of its column.
+        bool encode_row(int i, const double* pat);
+
+        // reserve -- Make room for at least "num_rows" coded input vectors,
+        //            keeping those already coded.  Return false on error.
+        bool reserve(int num_rows);
+
+};
 
 
 //
@@ -34,6 +143,7 @@ class PatternSet {
         int n_patterns;           // number of patterns
         int n_inputs;             // number of input values in each pattern
         int n_targets;            // number of target values in each pattern
+        int n_allocated;          // number of patterns that storage holds
 
         gsl_matrix* inputs_m;     // the matrix of input vectors, one per row
         gsl_matrix* targets_m;    // the matrix of target vectors, one per row
@@ -42,6 +152,54 @@ class PatternSet {
         int* permutation;         // the pattern indices, randomly permuted
         double* distances;        // distances to most recent target sort
 
+        double* norms;            // cached length of each input vector
+        gsl_matrix* unit_inputs_m;  // cached input vectors of unit length
+        float* float_inputs;      // cached single-precision input vectors
+        QuantizedInputs* quantized;  // cached byte coded input vectors
+
+        void* mapped_data;        // file mapped to hold the vectors, if any
+        size_t mapped_length;     // length of the mapped file, in bytes
+
+        // allocate_storage -- Replace any existing vectors with freshly
+        //                     allocated storage for the given numbers of
+        //                     patterns, inputs and targets.  Return false,
+        //                     leaving the pattern set invalid, on error.
+        bool allocate_storage(int num_pat, int num_inputs, int num_targets);
+
+        // release_storage -- Deallocate all vectors, arrays and caches, and
+        //                    unmap any file that the vectors came from.
+        void release_storage();
+
+        // euclidean_distances -- Fill the given array with the Euclidean
+        //                        distance of every input vector from the
+        //                        given reference vector.  Return false on
+        //                        error.
+        bool euclidean_distances(gsl_vector* ref_v, double* dist) const;
+
+        // angular_similarities -- Fill the given array with the inner product
+        //                         of every input vector with the given
+        //                         reference vector, divided by the length of
+        //                         the input vector.  Return false on error.
+        bool angular_similarities(gsl_vector* ref_v, double* sim) const;
+
+        // update_cached_row -- Bring the cached length, unit length copy,
+        //                      single-precision copy and byte coded copy of
+        //                      the "i"th input vector up to date, for
+        //                      whichever of the caches exist.  The byte
+        //                      coded copy is discarded if the vector no
+        //                      longer fits its column ranges.
+        void update_cached_row(int i);
+
+        // reset_empty -- Mark the pattern set as empty and owning nothing,
+        //                without freeing anything that it referred to.
+        void reset_empty();
+
+        // pca_project_into -- Fill the given pattern set with the projection
+        //                     of this one onto the principal component axes
+        //                     of the given model.  Return false on error.
+        bool pca_project_into(PatternSet& projected,
+                const PCAModel& model) const;
+
     public:
 
         // constructors & assignment
@@ -49,6 +207,22 @@ class PatternSet {
         PatternSet(const PatternSet& pset);
         PatternSet& operator=(const PatternSet& pset);
 
+        // Make a pattern set holding its own copy of the patterns that the
+        // given view covers, in their original order.
+        explicit PatternSet(const PatternView& view);
+
+#if __cplusplus >= 201103L
+        // Take over the storage of the given pattern set, without copying
+        // any vectors, leaving it empty.
+        PatternSet(PatternSet&& pset);
+        PatternSet& operator=(PatternSet&& pset);
+#endif
+
+        // swap -- Exchange the contents of this pattern set with those of the
+        //         given one, without copying any vectors.  Spatial and graph
+        //         indices follow the vectors that they were built over.
+        void swap(PatternSet& pset);
+
         // destructor
         ~PatternSet();
 
@@ -68,6 +242,16 @@ class PatternSet {
         //                      or a negative value on error.
         inline int number_of_targets() const { return n_targets; }
 
+        // input_matrix -- Return the matrix of input vectors, one per row, for
+        //                 read-only use by search structures built over the
+        //                 pattern set.  Return NULL if there are no inputs.
+        inline const gsl_matrix* input_matrix() const { return inputs_m; }
+
+        // target_matrix -- Return the matrix of target vectors, one per row,
+        //                  for read-only use.  Return NULL if there are no
+        //                  targets.
+        inline const gsl_matrix* target_matrix() const { return targets_m; }
+
         // get_permute_flag -- Return true if the permutation array is to be used
         //                     when writing patterns and performing other similar 
         //                     operations.  Return false if the original order of
@@ -125,11 +309,64 @@ class PatternSet {
         //                       negative value on error.
         int set_target_pattern(int i, gsl_vector* v);
 
+        // pattern_capacity -- Return the number of patterns that the pattern
+        //                     set can hold before its storage must grow.
+        inline int pattern_capacity() const { return n_allocated; }
+
+        // reserve -- Make sure that the pattern set can hold at least the
+        //            given number of patterns without its storage growing.
+        //            The matrices returned by "input_matrix" and
+        //            "target_matrix" remain the same objects, although their
+        //            elements move.  Vectors mapped from a file are copied
+        //            into storage of their own.  Return false on error.
+        bool reserve(int num_pat);
+
+        // append_pattern -- Add a pattern with the given input and target
+        //                   vectors to the end of the pattern set, doubling
+        //                   the storage when it is full, so that appending
+        //                   takes constant time on average.  Cached lengths
+        //                   and copies of the input vectors are extended, and
+        //                   any spatial or graph index over the input vectors
+        //                   may then be extended with its "append_point".
+        //                   An empty pattern set with no inputs and no
+        //                   targets, such as a default constructed one,
+        //                   takes the sizes of the given vectors; otherwise
+        //                   vectors of the wrong size are an error.  Return
+        //                   the index of the new pattern, or a negative
+        //                   value on error.
+        int append_pattern(gsl_vector* input_v, gsl_vector* target_v);
+
+        // erase_pattern -- Remove the "i"th pattern from the pattern set in
+        //                  constant time, by moving the last pattern into its
+        //                  place.  Cached lengths and copies of the input
+        //                  vectors follow the move, and any index over the
+        //                  input vectors should then be told with its
+        //                  "erase_point".  Return false on error.
+        bool erase_pattern(int i);
+
         // read -- Fill the pattern set from the contents of the given input
         //         stream, returning the stream, setting the appropriate error
         //         bits on the stream when an error occurs.
         friend istream& operator>>(istream& istr, PatternSet& pset);
 
+        // read_pattern_file -- Fill the pattern set from the named text file,
+        //                      as "operator>>" does, but faster.  See
+        //                      "pattern_io.h".
+        friend bool read_pattern_file(const char* file_name, PatternSet& pset,
+                int n_workers);
+
+        // read_unsized_pattern_file -- Fill the pattern set from the named text
+        //                             file, discovering its size as it is
+        //                             read.  See "pattern_io.h".
+        friend bool read_unsized_pattern_file(const char* file_name,
+                PatternSet& pset, int num_inputs, int num_targets);
+
+        // map_binary_pattern_file -- Make the pattern set refer to the
+        //                            vectors of the named binary pattern
+        //                            file in place.  See "pattern_io.h".
+        friend bool map_binary_pattern_file(const char* file_name,
+                PatternSet& pset);
+
         // write -- Write the complete pattern set, one pattern per line, to
         //          the given output stream, returning the stream and setting
         //          the appropriate error bits on error.
@@ -148,16 +385,218 @@ class PatternSet {
         //                   the given reference vector.  Return false on error.
         bool sort_euclidean(gsl_vector* ref_v);
 
+        // select_k_nearest -- Rearrange the permutation array so that its first
+        //                     "k" entries hold the indices of the "k" input
+        //                     vectors closest, in Euclidean distance, to the
+        //                     given reference vector, in order of increasing
+        //                     distance.  The remaining entries are left in an
+        //                     unspecified order.  Return false on error.
+        bool select_k_nearest(gsl_vector* ref_v, int k);
+
         // sort_angular -- Fill the permutation array so as to sort the input
         //                 vectors in order of increasing angular distance from
         //                 the given reference vector.  Return false on error.
         bool sort_angular(gsl_vector* ref_v);
 
+        // cache_norms -- Compute and keep the length of every input vector, so
+        //                that angular queries need not recompute them.  The
+        //                lengths are kept up to date by "set_input_pattern"
+        //                and discarded when patterns are read.  Return false
+        //                on error.
+        bool cache_norms();
+
+        // cache_unit_inputs -- Compute and keep a copy of the input vectors
+        //                      scaled to unit length, so that the angular
+        //                      similarities for a query take a single
+        //                      matrix-vector product.  This doubles the
+        //                      memory used by the input vectors.  The copy is
+        //                      maintained like the cached lengths.  Return
+        //                      false on error.
+        bool cache_unit_inputs();
+
+        // cache_float_inputs -- Compute and keep a single-precision copy of
+        //                       the input vectors, which Euclidean and
+        //                       angular queries then scan in place of the
+        //                       double-precision matrix, halving the memory
+        //                       traffic of each query.  Distances are still
+        //                       accumulated in double precision.  Unit length
+        //                       copies, when cached, take precedence for
+        //                       angular queries.  The copy is maintained like
+        //                       the cached lengths.  Return false on error.
+        bool cache_float_inputs();
+
+        // cache_quantized_inputs -- Compute and keep a copy of the input
+        //                           vectors with every value coded in a
+        //                           single byte, an eighth of the size of
+        //                           the input matrix.  Euclidean and angular
+        //                           queries then compare the reference vector
+        //                           against the codes directly, in preference
+        //                           to every other copy, and report distances
+        //                           between the reference vector and the
+        //                           decoded input vectors.  The copy is
+        //                           maintained like the cached lengths, but
+        //                           is discarded if "set_input_pattern"
+        //                           stores a value outside the range of its
+        //                           column.  The input matrix is kept as
+        //                           well, since the codes cannot give back
+        //                           the exact inputs that other members and
+        //                           search indices read, so this adds an
+        //                           eighth to the memory used by the inputs.
+        //                           What shrinks eightfold is the memory that
+        //                           each query scans.  Return false on
+        //                           error.
+        bool cache_quantized_inputs();
+
+        // clear_caches -- Discard the cached lengths and the unit length,
+        //                 single-precision and byte coded copies of the input
+        //                 vectors.
+        void clear_caches();
+
+        // nearest_euclidean -- Find the "k" input vectors closest, in Euclidean
+        //                      distance, to the given reference vector,
+        //                      writing their indices to "nearest_i" and their
+        //                      distances to "nearest_d", in order of
+        //                      increasing distance.  Intermediate results are
+        //                      kept in the given workspace rather than in the
+        //                      pattern set, so several threads may query the
+        //                      same pattern set at once.  Return the number of
+        //                      neighbors found, or a negative value on error.
+        int nearest_euclidean(gsl_vector* ref_v, int k, int* nearest_i,
+                double* nearest_d, QueryWorkspace& ws) const;
+
+        // nearest_angular -- Find the "k" input vectors closest, in angular
+        //                    distance, to the given reference vector, writing
+        //                    their indices to "nearest_i" and the values that
+        //                    "sort_angular" records as their distances to
+        //                    "nearest_d".  Like "nearest_euclidean", this
+        //                    leaves the pattern set unchanged.  Return the
+        //                    number of neighbors found, or a negative value on
+        //                    error.
+        int nearest_angular(gsl_vector* ref_v, int k, int* nearest_i,
+                double* nearest_d, QueryWorkspace& ws) const;
+
+        // view -- Return a view of the patterns with indices from "begin" up
+        //         to, but not including, "end", or of every pattern.  The
+        //         view holds no storage of its own, so it is only good until
+        //         the pattern set is resized or destroyed.
+        PatternView view(int begin, int end) const;
+        PatternView view() const;
+
+        // pca_projection -- Return a pattern set holding the input vectors
+        //                   of this one projected onto their leading
+        //                   principal component axes, along with copies of
+        //                   the target vectors and permutation sequence.
+        //                   The axes are those of a "PCAModel" fitted
+        //                   with the given arguments, so the projected
+        //                   vectors may be narrower than the input vectors.
+        //                   The projected vectors are written straight into
+        //                   the returned set, which is not copied again on
+        //                   return.  Return an empty pattern set on error.
+        PatternSet pca_projection(int n_components = 0,
+                double variance_fraction = 1.0, int n_workers = 1) const;
+
+        // pca_projection -- Return a pattern set holding the input vectors
+        //                   of this one projected onto the principal
+        //                   component axes of the given model, which may
+        //                   have been fitted to other patterns, along with
+        //                   copies of the target vectors and permutation
+        //                   sequence.  Return an empty pattern set on error.
+        PatternSet pca_projection(const PCAModel& model) const;
+
         // pca_project -- Return a copy of this pattern set with all input
         //                vectors projected onto their principal component axes.
         //                The copy should be freshly allocated.  Return the
-        //                original pattern set on error.
-        PatternSet& pca_project();
+        //                original pattern set on error.  "pca_projection"
+        //                does the same without leaving a copy to be freed.
+        PatternSet& pca_project(int n_workers = 1);
+
+};
+
+
+
+//
+// PatternView Class  --  A read-only window onto a contiguous range of the
+//                        patterns in a pattern set.  A view refers to the
+//                        vectors of the pattern set rather than copying
+//                        them, so it is cheap to make and to pass by value,
+//                        but it must not outlive the pattern set, nor be
+//                        used after patterns are appended to or erased from
+//                        it.  The permutation sequence is not part of the
+//                        view.
+//
+
+class PatternView {
+
+    private:
+
+        int n_patterns;           // number of patterns, or -1 if invalid
+        int n_inputs;             // number of input values in each pattern
+        int n_targets;            // number of target values in each pattern
+        int first;                // index of the first pattern in the set
+
+        gsl_matrix_const_view inputs_view;   // the viewed input vectors
+        gsl_matrix_const_view targets_view;  // the viewed target vectors
+
+    public:
+
+        // Make an empty view, or a view of the patterns of the given set
+        // with indices from "begin" up to, but not including, "end".  A
+        // range outside the pattern set gives an invalid view.
+        PatternView();
+        PatternView(const PatternSet& pset, int begin, int end);
+
+        // number_of_patterns -- Return the number of patterns in the view, or
+        //                       a negative value if the view is invalid.
+        inline int number_of_patterns() const { return n_patterns; }
+
+        // number_of_inputs -- Return the number of input values in each
+        //                     pattern.
+        inline int number_of_inputs() const { return n_inputs; }
+
+        // number_of_targets -- Return the number of target values in each
+        //                      pattern.
+        inline int number_of_targets() const { return n_targets; }
+
+        // first_pattern -- Return the index in the pattern set of the first
+        //                  pattern in the view.
+        inline int first_pattern() const { return first; }
+
+        // input_matrix -- Return the viewed input vectors, one per row, for
+        //                 read-only use by search structures.  Return NULL if
+        //                 there are none.
+        inline const gsl_matrix* input_matrix() const
+            { return (((n_patterns > 0) && (n_inputs > 0)) ?
+                    &inputs_view.matrix : NULL); }
+
+        // target_matrix -- Return the viewed target vectors, one per row.
+        //                  Return NULL if there are none.
+        inline const gsl_matrix* target_matrix() const
+            { return (((n_patterns > 0) && (n_targets > 0)) ?
+                    &targets_view.matrix : NULL); }
+
+        // input_row -- Return a pointer to the input values of the "i"th
+        //              pattern in the view.  The index is not checked.
+        inline const double* input_row(int i) const
+            { return (inputs_view.matrix.data + i * inputs_view.matrix.tda); }
+
+        // target_row -- Return a pointer to the target values of the "i"th
+        //               pattern in the view.  The index is not checked.
+        inline const double* target_row(int i) const
+            { return (targets_view.matrix.data + i * targets_view.matrix.tda); }
+
+        // input_pattern -- Copy the input vector for the "i"th pattern in the
+        //                  view into the given vector, returning a pointer to
+        //                  it.  Return NULL on error.
+        gsl_vector* input_pattern(int i, gsl_vector* v) const;
+
+        // target_pattern -- Copy the target vector for the "i"th pattern in
+        //                   the view into the given vector, returning a
+        //                   pointer to it.  Return NULL on error.
+        gsl_vector* target_pattern(int i, gsl_vector* v) const;
+
+        // subview -- Return a view of the patterns of this view with indices
+        //            from "begin" up to, but not including, "end".
+        PatternView subview(int begin, int end) const;
 
 };
 
@@ -0,0 +1,205 @@
+//
+// patterns_check
+//
+// This is a regression check for the "PatternSet" class, run by
+// "make check".  It appends patterns to sets holding each kind of cached
+// copy of their input vectors, both with and without spare storage, and
+// makes sure that queries against them agree with queries against a set
+// that caches nothing.  It also appends patterns to a default constructed
+// set, which has no inputs or targets until the first append.  The program
+// exits with a non-zero status if any check fails.
+//
+
+
+
+#include <iostream>
+#include <cmath>
+
+#include <gsl/gsl_vector.h>
+
+#include "patterns.h"
+
+using namespace std;
+
+
+// number of input values in each pattern
+static const int check_inputs = 3;
+// number of patterns held before any are appended
+static const int check_initial = 4;
+// number of patterns appended to each set
+static const int check_appended = 40;
+// number of neighbors compared for each query
+static const int check_k = 5;
+
+
+// fill_check_input -- Fill the given vector with the input values of the
+//                     "i"th check pattern.  Every value is a small integer
+//                     from 1 to 20, and the first two patterns hold the
+//                     extremes of every column, so that byte coded copies
+//                     are exact.
+static void fill_check_input(int i, gsl_vector* v) {
+    for (int j = 0; j < check_inputs; j++) {
+        double value;
+        if (i == 0)
+            value = 1.0;
+        else if (i == 1)
+            value = 20.0;
+        else
+            value = 1.0 + (i * 7 + j * 3) % 20;
+        gsl_vector_set(v, j, value);
+    }
+}
+
+
+// cache_inputs -- Build the cache of the pattern set named by "kind".
+//                 Return false on error.
+static bool cache_inputs(PatternSet& pset, int kind) {
+    switch (kind) {
+        case 0:
+            return (pset.cache_norms());
+        case 1:
+            return (pset.cache_unit_inputs());
+        case 2:
+            return (pset.cache_float_inputs());
+        default:
+            return (pset.cache_quantized_inputs());
+    }
+}
+
+
+// same_neighbors -- Return true if the given pattern sets report the same
+//                   distances for the nearest neighbors of every check
+//                   pattern, by both Euclidean and angular distance.
+static bool same_neighbors(const PatternSet& pset, const PatternSet& plain) {
+    gsl_vector* ref_v = gsl_vector_alloc(check_inputs);
+    QueryWorkspace ws;
+    int nearest_i[check_k];
+    double nearest_d[check_k];
+    int plain_i[check_k];
+    double plain_d[check_k];
+    bool same = true;
+
+    for (int q = 0; same && (q < check_initial + check_appended); q++) {
+        fill_check_input(q + 3, ref_v);
+        for (int angular = 0; same && (angular < 2); angular++) {
+            int found, plain_found;
+            if (angular) {
+                found = pset.nearest_angular(ref_v, check_k, nearest_i,
+                        nearest_d, ws);
+                plain_found = plain.nearest_angular(ref_v, check_k, plain_i,
+                        plain_d, ws);
+            } else {
+                found = pset.nearest_euclidean(ref_v, check_k, nearest_i,
+                        nearest_d, ws);
+                plain_found = plain.nearest_euclidean(ref_v, check_k,
+                        plain_i, plain_d, ws);
+            }
+            if ((found != check_k) || (plain_found != check_k))
+                same = false;
+            for (int t = 0; same && (t < check_k); t++)
+                if (fabs(nearest_d[t] - plain_d[t]) > 1.0e-6)
+                    same = false;
+        }
+    }
+    gsl_vector_free(ref_v);
+    return (same);
+}
+
+
+// check_append -- Cache the input vectors of a small pattern set in the
+//                 way named by "kind", optionally after reserving spare
+//                 storage, then append patterns to it and compare it with
+//                 a set that caches nothing.  Return false on failure.
+static bool check_append(int kind, bool spare) {
+    gsl_vector* input_v = gsl_vector_alloc(check_inputs);
+    gsl_vector* target_v = gsl_vector_alloc(1);
+    PatternSet pset(check_initial, check_inputs, 1);
+    PatternSet plain(check_initial, check_inputs, 1);
+    bool ok = true;
+
+    gsl_vector_set(target_v, 0, 0.0);
+    for (int i = 0; i < check_initial; i++) {
+        fill_check_input(i, input_v);
+        (void) pset.set_input_pattern(i, input_v);
+        (void) plain.set_input_pattern(i, input_v);
+    }
+    if ((spare && !pset.reserve(check_initial + check_appended)) ||
+            !cache_inputs(pset, kind))
+        ok = false;
+    for (int i = check_initial; ok && (i < check_initial + check_appended);
+            i++) {
+        fill_check_input(i, input_v);
+        if ((pset.append_pattern(input_v, target_v) != i) ||
+                (plain.append_pattern(input_v, target_v) != i))
+            ok = false;
+    }
+    if (ok)
+        ok = same_neighbors(pset, plain);
+    gsl_vector_free(input_v);
+    gsl_vector_free(target_v);
+    return (ok);
+}
+
+
+// check_shapeless -- Append patterns to a default constructed pattern
+//                    set, which should take the sizes of the first
+//                    vectors appended and keep their values.  Return false
+//                    on failure.
+static bool check_shapeless() {
+    gsl_vector* input_v = gsl_vector_alloc(check_inputs);
+    gsl_vector* wrong_v = gsl_vector_alloc(check_inputs + 1);
+    gsl_vector* target_v = gsl_vector_alloc(1);
+    gsl_vector* copy_v = gsl_vector_alloc(check_inputs);
+    PatternSet pset;
+    bool ok = true;
+
+    gsl_vector_set_zero(wrong_v);
+    for (int i = 0; ok && (i < check_appended); i++) {
+        fill_check_input(i, input_v);
+        gsl_vector_set(target_v, 0, (double) i);
+        if ((pset.append_pattern(input_v, target_v) != i) ||
+                (pset.append_pattern(wrong_v, target_v) >= 0) ||
+                (pset.append_pattern(input_v, NULL) >= 0))
+            ok = false;
+    }
+    if ((pset.number_of_patterns() != check_appended) ||
+            (pset.number_of_inputs() != check_inputs) ||
+            (pset.number_of_targets() != 1))
+        ok = false;
+    for (int i = 0; ok && (i < check_appended); i++) {
+        fill_check_input(i, input_v);
+        if ((pset.input_pattern(i, copy_v) == NULL) ||
+                (pset.target_pattern(i, target_v) == NULL) ||
+                (gsl_vector_get(target_v, 0) != (double) i))
+            ok = false;
+        for (int j = 0; ok && (j < check_inputs); j++)
+            if (gsl_vector_get(copy_v, j) != gsl_vector_get(input_v, j))
+                ok = false;
+    }
+    gsl_vector_free(input_v);
+    gsl_vector_free(wrong_v);
+    gsl_vector_free(target_v);
+    gsl_vector_free(copy_v);
+    return (ok);
+}
+
+
+int main() {
+    const char* kind_names[] = { "norms", "unit inputs", "float inputs",
+        "quantized inputs" };
+    int failures = 0;
+
+    for (int kind = 0; kind < 4; kind++)
+        for (int spare = 0; spare < 2; spare++)
+            if (!check_append(kind, spare != 0)) {
+                cerr << "append after caching " << kind_names[kind]
+                     << (spare ? " with spare storage" : "")
+                     << " failed" << endl;
+                failures++;
+            }
+    if (!check_shapeless()) {
+        cerr << "append to a default constructed pattern set failed" << endl;
+        failures++;
+    }
+    return ((failures > 0) ? 1 : 0);
+}
@@ -0,0 +1,861 @@
+//
+// pca_model.cc :  Implementation file for a principal component analysis of
+//                 the input vectors of a "pattern set" object.
+//
+
+
+#include <algorithm>
+#include <vector>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_eigen.h>
+#include <gsl/gsl_rng.h>
+
+#include "patterns.h"
+#include "pca_model.h"
+#include "distance.h"
+
+
+// number of rows centered and multiplied together at a time when computing
+// a covariance matrix
+static const int covariance_block_rows = 256;
+
+
+// CovarianceChunk -- The share of the rows of a data matrix whose
+//                    contribution to a covariance matrix is computed by one
+//                    worker thread.
+struct CovarianceChunk {
+    const gsl_matrix* data_m; // the data vectors, one per row
+    const gsl_vector* means_v;  // the mean of each data feature
+    int first_row;            // first row of the chunk
+    int end_row;              // one past the last row of the chunk
+    gsl_matrix* sum_m;        // sum of the outer products of the centered
+                              // rows, lower triangle only
+    bool ok;                  // true once the chunk has been summed
+};
+
+
+// covariance_chunk_worker -- Add the outer products of the centered rows
+//                            of a single chunk into its sum, one block of
+//                            rows at a time.  Each block is centered into
+//                            a scratch matrix, so that a single rank-k
+//                            update covers all of its rows.
+static void* covariance_chunk_worker(void* arg) {
+    CovarianceChunk* chunk = (CovarianceChunk*) arg;
+    int d = chunk->data_m->size2;
+    int block_rows = std::min(covariance_block_rows,
+            chunk->end_row - chunk->first_row);
+
+    chunk->ok = true;
+    if (block_rows <= 0)
+        return (NULL);
+    gsl_matrix* block_m = gsl_matrix_alloc(block_rows, d);
+    if (block_m == NULL) {
+        chunk->ok = false;
+        return (NULL);
+    }
+    vector<double> means(d);
+    for (int j = 0; j < d; j++)
+        means[j] = gsl_vector_get(chunk->means_v, j);
+    for (int begin = chunk->first_row; begin < chunk->end_row;
+            begin += block_rows) {
+        int n = std::min(block_rows, chunk->end_row - begin);
+        // center the rows of this block ...
+        for (int r = 0; r < n; r++) {
+            const double* x = gsl_matrix_const_ptr(chunk->data_m, begin + r, 0);
+            double* centered = gsl_matrix_ptr(block_m, r, 0);
+            for (int j = 0; j < d; j++)
+                centered[j] = x[j] - means[j];
+        }
+        // ... and add their outer products to the sum ...
+        gsl_matrix_view rows_v_view = gsl_matrix_submatrix(block_m, 0, 0, n, d);
+        (void) gsl_blas_dsyrk(CblasLower, CblasTrans, 1.0,
+                &rows_v_view.matrix, 1.0, chunk->sum_m);
+    }
+    gsl_matrix_free(block_m);
+    return (NULL);
+}
+
+
+// sum_centered_products -- Fill the lower triangle of "sum_m" with the sum
+//                          of the outer products of the rows of "data_m",
+//                          less the given column means.  The rows are
+//                          split into contiguous chunks across "n_workers"
+//                          threads, each of which sums its centered rows a
+//                          block at a time, with one "dsyrk" per block
+//                          rather than one pass over the data per pair of
+//                          features.  Return false on error.
+
+static bool sum_centered_products(gsl_matrix* sum_m, const gsl_matrix* data_m,
+        const gsl_vector* means_v, int n_workers) {
+    int n;             // number of data vectors
+    int d;             // dimensionality of data space
+
+    if ((sum_m == NULL) || (data_m == NULL) || (means_v == NULL))
+        return (false);
+    n = data_m->size1;
+    d = data_m->size2;
+    if ((n <= 0) || (d <= 0) || (d != sum_m->size1) || (d != sum_m->size2) ||
+            (d != means_v->size))
+        return (false);
+    // give each worker at least one block of rows ...
+    int n_blocks = (n + covariance_block_rows - 1) / covariance_block_rows;
+    if (n_workers > n_blocks)
+        n_workers = n_blocks;
+    if (n_workers < 1)
+        n_workers = 1;
+    // the first worker sums straight into "sum_m", and the others into
+    // matrices of their own ...
+    vector<CovarianceChunk> chunks(n_workers);
+    bool ok = true;
+    for (int w = 0; w < n_workers; w++) {
+        chunks[w].data_m = data_m;
+        chunks[w].means_v = means_v;
+        chunks[w].first_row = (int) (((long) n * w) / n_workers);
+        chunks[w].end_row = (int) (((long) n * (w + 1)) / n_workers);
+        chunks[w].sum_m = (w == 0) ? sum_m : gsl_matrix_alloc(d, d);
+        chunks[w].ok = false;
+        if (chunks[w].sum_m)
+            gsl_matrix_set_zero(chunks[w].sum_m);
+        else
+            ok = false;
+    }
+    if (ok) {
+        vector<pthread_t> threads(n_workers);
+        vector<bool> started(n_workers, false);
+        for (int w = 1; w < n_workers; w++)
+            started[w] = (pthread_create(&threads[w], NULL,
+                        covariance_chunk_worker, &chunks[w]) == 0);
+        (void) covariance_chunk_worker(&chunks[0]);
+        for (int w = 1; w < n_workers; w++) {
+            if (started[w])
+                (void) pthread_join(threads[w], NULL);
+            else
+                (void) covariance_chunk_worker(&chunks[w]);
+        }
+    }
+    // add up the sums of the chunks, in a fixed order ...
+    for (int w = 0; w < n_workers; w++) {
+        ok = ok && chunks[w].ok;
+        if ((w > 0) && chunks[w].sum_m) {
+            if (ok)
+                for (int j1 = 0; j1 < d; j1++) {
+                    double* total = gsl_matrix_ptr(sum_m, j1, 0);
+                    const double* part
+                        = gsl_matrix_const_ptr(chunks[w].sum_m, j1, 0);
+                    for (int j2 = 0; j2 <= j1; j2++)
+                        total[j2] += part[j2];
+                }
+            gsl_matrix_free(chunks[w].sum_m);
+        }
+    }
+    return (ok);
+}
+
+
+// covariance_matrix -- This utility function returns the covariance
+//                      matrix associated with the given matrix of
+//                      pattern vectors.  Storage for the matrix is
+//                      passed in as the first argument.  The mean of
+//                      each data feature is passed in as a vector.
+//                      The work is shared by "n_workers" threads.
+//                      Return NULL on error.
+
+gsl_matrix* covariance_matrix(gsl_matrix* cov_m, const gsl_matrix* data_m, 
+        const gsl_vector* means_v, int n_workers) {
+    if (!sum_centered_products(cov_m, data_m, means_v, n_workers))
+        return (NULL);
+    int n = data_m->size1;
+    int d = data_m->size2;
+    // scale by "n - 1", as "gsl_stats_covariance_m" does, and fill in the
+    // upper triangle ...
+    double scale = (n > 1) ? (1.0 / (n - 1)) : 0.0;
+    for (int j1 = 0; j1 < d; j1++)
+        for (int j2 = 0; j2 <= j1; j2++) {
+            double cov_value = gsl_matrix_get(cov_m, j1, j2) * scale;
+            gsl_matrix_set(cov_m, j1, j2, cov_value);
+            gsl_matrix_set(cov_m, j2, j1, cov_value);
+        }
+    return (cov_m);
+}
+
+
+// column_means -- Fill the given vector with the mean of each column of the
+//                 given matrix, reading the matrix row by row.
+
+static void column_means(const gsl_matrix* data_m, gsl_vector* means_v) {
+    int n = data_m->size1;
+    int d = data_m->size2;
+    vector<double> sums(d, 0.0);
+
+    for (int i = 0; i < n; i++) {
+        const double* x = gsl_matrix_const_ptr(data_m, i, 0);
+        for (int j = 0; j < d; j++)
+            sums[j] += x[j];
+    }
+    for (int j = 0; j < d; j++)
+        gsl_vector_set(means_v, j, sums[j] / n);
+}
+
+
+// number of directions tracked by the randomized eigensolver beyond the
+// number of principal components requested
+static const int pca_oversampling = 10;
+
+// the randomized eigensolver stops once the eigenvalue estimates of the
+// components requested all change by no more than this fraction from one
+// subspace iteration to the next ...
+static const double pca_ritz_tolerance = 1.0e-8;
+
+// ... or after this many subspace iterations, when the eigenvalues are too
+// close together for the iteration to separate them quickly
+static const int pca_max_power_iterations = 20;
+
+
+// orthonormalize_rows -- Replace the rows of the given matrix by an
+//                        orthonormal basis for the space they span, using
+//                        modified Gram-Schmidt twice over for stability.
+//                        A row that depends on the rows above it is left as
+//                        zero.
+
+static void orthonormalize_rows(gsl_matrix* basis_m) {
+    int l = basis_m->size1;
+    int d = basis_m->size2;
+
+    for (int pass = 0; pass < 2; pass++)
+        for (int r = 0; r < l; r++) {
+            double* v = gsl_matrix_ptr(basis_m, r, 0);
+            for (int p = 0; p < r; p++) {
+                const double* u = gsl_matrix_const_ptr(basis_m, p, 0);
+                double overlap = dot_product(u, v, d);
+                for (int j = 0; j < d; j++)
+                    v[j] -= overlap * u[j];
+            }
+            double length = sqrt(dot_product(v, v, d));
+            double scale = (length > 0.0) ? (1.0 / length) : 0.0;
+            for (int j = 0; j < d; j++)
+                v[j] *= scale;
+        }
+}
+
+
+// randomized_eigenvectors -- Approximate the leading eigenvectors of the
+//                            given symmetric matrix by subspace iteration
+//                            from a random start, writing as many of them
+//                            as "basis_m" has rows to its rows, and their
+//                            eigenvalues to "eval_v", in order of decreasing
+//                            eigenvalue.  Each iteration costs one product
+//                            of the matrix with the basis, rather than the
+//                            full decomposition, and iteration stops once
+//                            the first "n_wanted" eigenvalues have settled
+//                            to within "pca_ritz_tolerance".  Return false
+//                            on error.
+
+static bool randomized_eigenvectors(const gsl_matrix* sym_m,
+        gsl_matrix* basis_m, gsl_vector* eval_v, int n_wanted) {
+    int l = basis_m->size1;
+    int d = basis_m->size2;
+
+    // Use the random number algorithm and seed given by the GSL_RNG_TYPE
+    // and GSL_RNG_SEED environment variables, as "permute_patterns" does ...
+    (void) gsl_rng_env_setup();
+    gsl_rng* rand_generator = gsl_rng_alloc(gsl_rng_default);
+    gsl_matrix* product_m = gsl_matrix_alloc(l, d);
+    gsl_matrix* small_m = gsl_matrix_alloc(l, l);
+    gsl_matrix* small_evec_m = gsl_matrix_alloc(l, l);
+    gsl_eigen_symmv_workspace* ws = gsl_eigen_symmv_alloc(l);
+    vector<double> last_evals(n_wanted);
+    bool ok = rand_generator && product_m && small_m && small_evec_m && ws;
+    if (ok) {
+        for (int r = 0; r < l; r++)
+            for (int j = 0; j < d; j++)
+                gsl_matrix_set(basis_m, r, j,
+                        gsl_rng_uniform(rand_generator) - 0.5);
+        orthonormalize_rows(basis_m);
+        for (int it = 0; ; it++) {
+            // the rows of "basis_m" times the (symmetric) matrix are the
+            // matrix times its basis vectors.  Solve the small eigenproblem
+            // of the matrix restricted to the basis, whose eigenvalues
+            // estimate those of the matrix ...
+            (void) gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, basis_m,
+                    sym_m, 0.0, product_m);
+            (void) gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, product_m,
+                    basis_m, 0.0, small_m);
+            (void) gsl_eigen_symmv(small_m, eval_v, small_evec_m, ws);
+            (void) gsl_eigen_symmv_sort(eval_v, small_evec_m,
+                    GSL_EIGEN_SORT_VAL_DESC);
+            // ... and stop once the estimates of the wanted ones settle,
+            // measuring the smallest against the largest ...
+            double top = fabs(gsl_vector_get(eval_v, 0));
+            bool settled = (it > 0);
+            for (int c = 0; c < n_wanted; c++) {
+                double value = gsl_vector_get(eval_v, c);
+                if (fabs(value - last_evals[c]) > pca_ritz_tolerance *
+                        std::max(fabs(value), DBL_EPSILON * top))
+                    settled = false;
+                last_evals[c] = value;
+            }
+            if (settled || (it == pca_max_power_iterations))
+                break;
+            (void) gsl_matrix_memcpy(basis_m, product_m);
+            orthonormalize_rows(basis_m);
+        }
+        // rotate the basis onto the eigenvectors of the small problem ...
+        (void) gsl_blas_dgemm(CblasTrans, CblasNoTrans, 1.0, small_evec_m,
+                basis_m, 0.0, product_m);
+        (void) gsl_matrix_memcpy(basis_m, product_m);
+    }
+    if (rand_generator)
+        gsl_rng_free(rand_generator);
+    if (product_m)
+        gsl_matrix_free(product_m);
+    if (small_m)
+        gsl_matrix_free(small_m);
+    if (small_evec_m)
+        gsl_matrix_free(small_evec_m);
+    if (ws)
+        gsl_eigen_symmv_free(ws);
+    return (ok);
+}
+
+
+// principal_components -- Find the leading eigenvectors of the given
+//                         covariance matrix, returning them as the rows of
+//                         a freshly allocated matrix in order of decreasing
+//                         eigenvalue, with their eigenvalues in a freshly
+//                         allocated vector.  At most "n_components" are
+//                         kept (all of them if it is not positive), and no
+//                         more than are needed to account for
+//                         "variance_fraction" of the total variance.  When
+//                         only a few components are asked for, they are
+//                         found by subspace iteration instead of a full
+//                         decomposition.  The covariance matrix is
+//                         destroyed.  Return the number of components kept,
+//                         or a negative value on error.
+
+static int principal_components(gsl_matrix* cov_m, int n_components,
+        double variance_fraction, gsl_matrix** components_m,
+        gsl_vector** eigenvalues_v) {
+    int d = cov_m->size1;
+    gsl_matrix* evec_m = NULL;  // eigenvectors, one per row
+    gsl_vector* eval_v = NULL;  // their eigenvalues, largest first
+
+    *components_m = NULL;
+    *eigenvalues_v = NULL;
+    if ((n_components <= 0) || (n_components > d))
+        n_components = d;
+    // a fixed number of components may be found without a full
+    // decomposition ...
+    int n_partial = n_components + pca_oversampling;
+    if ((variance_fraction >= 1.0) && (2 * n_partial <= d)) {
+        evec_m = gsl_matrix_alloc(n_partial, d);
+        eval_v = gsl_vector_alloc(n_partial);
+        if (!evec_m || !eval_v ||
+                !randomized_eigenvectors(cov_m, evec_m, eval_v,
+                    n_components)) {
+            if (evec_m)
+                gsl_matrix_free(evec_m);
+            if (eval_v)
+                gsl_vector_free(eval_v);
+            return (-1);
+        }
+    } else {
+        gsl_matrix* evec_cols_m = gsl_matrix_alloc(d, d);
+        eval_v = gsl_vector_alloc(d);
+        gsl_eigen_symmv_workspace* ws = gsl_eigen_symmv_alloc(d);
+        evec_m = gsl_matrix_alloc(d, d);
+        bool ok = evec_cols_m && eval_v && ws && evec_m;
+        if (ok) {
+            (void) gsl_eigen_symmv(cov_m, eval_v, evec_cols_m, ws);
+            (void) gsl_eigen_symmv_sort(eval_v, evec_cols_m,
+                    GSL_EIGEN_SORT_VAL_DESC);
+            (void) gsl_matrix_transpose_memcpy(evec_m, evec_cols_m);
+        }
+        if (evec_cols_m)
+            gsl_matrix_free(evec_cols_m);
+        if (ws)
+            gsl_eigen_symmv_free(ws);
+        if (!ok) {
+            if (evec_m)
+                gsl_matrix_free(evec_m);
+            if (eval_v)
+                gsl_vector_free(eval_v);
+            return (-1);
+        }
+        // keep only as many components as explain the variance asked
+        // for, the total variance being the sum of all the eigenvalues ...
+        if (variance_fraction < 1.0) {
+            double total = 0.0;
+            for (int c = 0; c < d; c++)
+                total += std::max(gsl_vector_get(eval_v, c), 0.0);
+            double explained = 0.0;
+            int needed = 1;
+            for (int c = 0; (c < d) &&
+                    (explained < variance_fraction * total); c++) {
+                explained += std::max(gsl_vector_get(eval_v, c), 0.0);
+                needed = c + 1;
+            }
+            n_components = std::min(n_components, needed);
+        }
+    }
+    *components_m = gsl_matrix_alloc(n_components, d);
+    *eigenvalues_v = gsl_vector_alloc(n_components);
+    if ((*components_m == NULL) || (*eigenvalues_v == NULL)) {
+        if (*components_m)
+            gsl_matrix_free(*components_m);
+        if (*eigenvalues_v)
+            gsl_vector_free(*eigenvalues_v);
+        *components_m = NULL;
+        *eigenvalues_v = NULL;
+        n_components = -1;
+    } else {
+        gsl_matrix_const_view kept_m_view
+            = gsl_matrix_const_submatrix(evec_m, 0, 0, n_components, d);
+        (void) gsl_matrix_memcpy(*components_m, &kept_m_view.matrix);
+        for (int c = 0; c < n_components; c++)
+            gsl_vector_set(*eigenvalues_v, c, gsl_vector_get(eval_v, c));
+    }
+    gsl_matrix_free(evec_m);
+    gsl_vector_free(eval_v);
+    return (n_components);
+}
+
+
+// project_onto_components -- Write the projection of each row of "data_m",
+//                            less the means, onto the rows of
+//                            "components_m" to the matching row of
+//                            "projected_m".  Rows are centered a block at a
+//                            time, and each block is projected with a
+//                            single matrix multiply.  Return false on
+//                            error.
+
+static bool project_onto_components(const gsl_matrix* data_m,
+        const gsl_vector* means_v, const gsl_matrix* components_m,
+        gsl_matrix* projected_m) {
+    int n = data_m->size1;
+    int d = data_m->size2;
+    int k = components_m->size1;
+    int block_rows = std::min(covariance_block_rows, n);
+
+    if ((n <= 0) || (components_m->size2 != d) || (means_v->size != d) ||
+            (projected_m->size1 != n) || (projected_m->size2 != k))
+        return (false);
+    gsl_matrix* block_m = gsl_matrix_alloc(block_rows, d);
+    if (block_m == NULL)
+        return (false);
+    vector<double> means(d);
+    for (int j = 0; j < d; j++)
+        means[j] = gsl_vector_get(means_v, j);
+    for (int begin = 0; begin < n; begin += block_rows) {
+        int rows = std::min(block_rows, n - begin);
+        // center the rows of this block ...
+        for (int r = 0; r < rows; r++) {
+            const double* x = gsl_matrix_const_ptr(data_m, begin + r, 0);
+            double* centered = gsl_matrix_ptr(block_m, r, 0);
+            for (int j = 0; j < d; j++)
+                centered[j] = x[j] - means[j];
+        }
+        // ... and project them all at once ...
+        gsl_matrix_view rows_m_view = gsl_matrix_submatrix(block_m, 0, 0,
+                rows, d);
+        gsl_matrix_view out_m_view = gsl_matrix_submatrix(projected_m, begin,
+                0, rows, k);
+        (void) gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0,
+                &rows_m_view.matrix, components_m, 0.0, &out_m_view.matrix);
+    }
+    gsl_matrix_free(block_m);
+    return (true);
+}
+
+
+//
+// CovarianceAccumulator Class  --  Member function implementations
+//
+
+// constructor
+
+CovarianceAccumulator::CovarianceAccumulator(int num_inputs) {
+    n_inputs = (num_inputs > 0) ? num_inputs : 0;
+    n_rows = 0;
+    means.assign(n_inputs, 0.0);
+    sums_m = NULL;
+    block_means_v = NULL;
+    block_sums_m = NULL;
+    if (n_inputs > 0) {
+        sums_m = gsl_matrix_calloc(n_inputs, n_inputs);
+        block_means_v = gsl_vector_alloc(n_inputs);
+        block_sums_m = gsl_matrix_alloc(n_inputs, n_inputs);
+    }
+    if ((sums_m == NULL) || (block_means_v == NULL) || (block_sums_m == NULL))
+        n_inputs = 0;
+}
+
+
+// destructor
+
+CovarianceAccumulator::~CovarianceAccumulator() {
+    if (sums_m)
+        gsl_matrix_free(sums_m);
+    if (block_means_v)
+        gsl_vector_free(block_means_v);
+    if (block_sums_m)
+        gsl_matrix_free(block_sums_m);
+    n_inputs = 0;
+    n_rows = 0;
+}
+
+
+// combine -- Fold the count, means and sums of another part of the stream
+//            into this accumulator.  The sums about the two separate means
+//            are shifted to the combined mean by the outer product of the
+//            difference between the means, as in the pairwise update of
+//            Chan, Golub and LeVeque.
+
+void CovarianceAccumulator::combine(long other_rows, const double* other_means,
+        const gsl_matrix* other_sums_m) {
+    if (other_rows <= 0)
+        return;
+    long total_rows = n_rows + other_rows;
+    double weight = ((double) n_rows * (double) other_rows) / total_rows;
+    double share = (double) other_rows / total_rows;
+    vector<double> delta(n_inputs);
+    for (int j = 0; j < n_inputs; j++)
+        delta[j] = other_means[j] - means[j];
+    for (int j1 = 0; j1 < n_inputs; j1++) {
+        double* total = gsl_matrix_ptr(sums_m, j1, 0);
+        const double* part = gsl_matrix_const_ptr(other_sums_m, j1, 0);
+        for (int j2 = 0; j2 <= j1; j2++)
+            total[j2] += part[j2] + weight * delta[j1] * delta[j2];
+    }
+    for (int j = 0; j < n_inputs; j++)
+        means[j] += share * delta[j];
+    n_rows = total_rows;
+}
+
+
+// add -- Add the rows of the given matrix to the stream, summing them with
+//        "n_workers" threads.  Return false on error.
+
+bool CovarianceAccumulator::add(const gsl_matrix* rows_m, int n_workers) {
+    if ((n_inputs <= 0) || (rows_m == NULL) || (rows_m->size2 != n_inputs))
+        return (false);
+    if (rows_m->size1 == 0)
+        return (true);
+    column_means(rows_m, block_means_v);
+    if (!sum_centered_products(block_sums_m, rows_m, block_means_v,
+                n_workers))
+        return (false);
+    vector<double> block_means(n_inputs);
+    for (int j = 0; j < n_inputs; j++)
+        block_means[j] = gsl_vector_get(block_means_v, j);
+    combine(rows_m->size1, &block_means[0], block_sums_m);
+    return (true);
+}
+
+
+// merge -- Add the input vectors that another accumulator has seen to this
+//          one.  Return false if the accumulators are for vectors of
+//          different lengths.
+
+bool CovarianceAccumulator::merge(const CovarianceAccumulator& acc) {
+    if ((n_inputs <= 0) || (acc.n_inputs != n_inputs) || (&acc == this))
+        return (false);
+    if (acc.n_rows > 0)
+        combine(acc.n_rows, &acc.means[0], acc.sums_m);
+    return (true);
+}
+
+
+// mean_vector -- Copy the mean of each input value into the given vector,
+//                returning a pointer to it.  Return NULL on error.
+
+gsl_vector* CovarianceAccumulator::mean_vector(gsl_vector* means_v) const {
+    if ((n_inputs <= 0) || (means_v == NULL) || (means_v->size != n_inputs))
+        return (NULL);
+    for (int j = 0; j < n_inputs; j++)
+        gsl_vector_set(means_v, j, means[j]);
+    return (means_v);
+}
+
+
+// covariance -- Fill the given matrix with the covariance matrix of the
+//               input vectors added, returning a pointer to it.  Return
+//               NULL on error.
+
+gsl_matrix* CovarianceAccumulator::covariance(gsl_matrix* cov_m) const {
+    if ((n_inputs <= 0) || (cov_m == NULL) || (cov_m->size1 != n_inputs) ||
+            (cov_m->size2 != n_inputs))
+        return (NULL);
+    // scale by "n - 1", as "covariance_matrix" does ...
+    double scale = (n_rows > 1) ? (1.0 / (n_rows - 1)) : 0.0;
+    for (int j1 = 0; j1 < n_inputs; j1++)
+        for (int j2 = 0; j2 <= j1; j2++) {
+            double cov_value = gsl_matrix_get(sums_m, j1, j2) * scale;
+            gsl_matrix_set(cov_m, j1, j2, cov_value);
+            gsl_matrix_set(cov_m, j2, j1, cov_value);
+        }
+    return (cov_m);
+}
+
+
+// PCAFileHeader -- The layout of the start of a saved model.  The header is
+//                  followed by the means, then the eigenvalues, then the
+//                  principal axes row by row, all as native doubles.
+struct PCAFileHeader {
+    char magic[8];            // "PCAMODL" and a null
+    uint32_t byte_order;      // "pca_byte_order", as written
+    uint32_t version;         // "pca_file_version"
+    uint32_t n_inputs;        // number of values in each input vector
+    uint32_t n_components;    // number of principal axes
+};
+
+static const char pca_magic[8] = { 'P', 'C', 'A', 'M', 'O', 'D', 'L', '\0' };
+static const uint32_t pca_byte_order = 0x01020304;
+static const uint32_t pca_file_version = 1;
+
+
+//
+// PCAModel Class  --  Member function implementations
+//
+
+// constructors
+
+PCAModel::PCAModel() {
+    n_inputs = 0;
+    n_components = 0;
+    means_v = NULL;
+    components_m = NULL;
+    eigenvalues_v = NULL;
+}
+
+PCAModel::PCAModel(const PatternSet& pset, int n_components,
+        double variance_fraction, int n_workers) {
+    const gsl_matrix* inputs_m = pset.input_matrix();
+
+    n_inputs = 0;
+    this->n_components = 0;
+    means_v = NULL;
+    components_m = NULL;
+    eigenvalues_v = NULL;
+    if ((inputs_m == NULL) || (pset.number_of_patterns() <= 0))
+        return;
+    n_inputs = pset.number_of_inputs();
+    // compute the vector element means ...
+    means_v = gsl_vector_alloc(n_inputs);
+    gsl_matrix* cov_m = gsl_matrix_alloc(n_inputs, n_inputs);
+    if ((means_v == NULL) || (cov_m == NULL)) {
+        if (cov_m)
+            gsl_matrix_free(cov_m);
+        release();
+        return;
+    }
+    column_means(inputs_m, means_v);
+    // compute the covariance matrix, and its leading eigenvectors ...
+    if (covariance_matrix(cov_m, inputs_m, means_v, n_workers))
+        fit(cov_m, n_components, variance_fraction);
+    else
+        release();
+    gsl_matrix_free(cov_m);
+}
+
+PCAModel::PCAModel(const CovarianceAccumulator& acc, int n_components,
+        double variance_fraction) {
+    n_inputs = 0;
+    this->n_components = 0;
+    means_v = NULL;
+    components_m = NULL;
+    eigenvalues_v = NULL;
+    if ((acc.number_of_inputs() <= 0) || (acc.number_of_rows() <= 0))
+        return;
+    n_inputs = acc.number_of_inputs();
+    means_v = gsl_vector_alloc(n_inputs);
+    gsl_matrix* cov_m = gsl_matrix_alloc(n_inputs, n_inputs);
+    if (means_v && cov_m && acc.mean_vector(means_v) && acc.covariance(cov_m))
+        fit(cov_m, n_components, variance_fraction);
+    else
+        release();
+    if (cov_m)
+        gsl_matrix_free(cov_m);
+}
+
+
+// fit -- Find the principal axes of the given covariance matrix, given that
+//        the means are already set.  The covariance matrix is destroyed.
+
+void PCAModel::fit(gsl_matrix* cov_m, int n_components,
+        double variance_fraction) {
+    int k = principal_components(cov_m, n_components, variance_fraction,
+            &components_m, &eigenvalues_v);
+    if (k <= 0) {
+        release();
+        return;
+    }
+    this->n_components = k;
+}
+
+
+// destructor
+
+PCAModel::~PCAModel() {
+    release();
+}
+
+
+// release -- Deallocate the means, axes and eigenvalues.
+
+void PCAModel::release() {
+    if (means_v) {
+        gsl_vector_free(means_v);
+        means_v = NULL;
+    }
+    if (components_m) {
+        gsl_matrix_free(components_m);
+        components_m = NULL;
+    }
+    if (eigenvalues_v) {
+        gsl_vector_free(eigenvalues_v);
+        eigenvalues_v = NULL;
+    }
+    n_components = 0;
+}
+
+
+// transform -- Project each row of "inputs_m", less the means, onto the
+//              principal axes, writing the result to the matching row of
+//              "projected_m".  Return false on error.
+
+bool PCAModel::transform(const gsl_matrix* inputs_m,
+        gsl_matrix* projected_m) const {
+    if ((n_components <= 0) || (inputs_m == NULL) || (projected_m == NULL))
+        return (false);
+    return (project_onto_components(inputs_m, means_v, components_m,
+                projected_m));
+}
+
+
+// transform -- Project the given input vector onto the principal axes,
+//              writing the result to "projected_v", returning a pointer to
+//              it.  Return NULL on error.
+
+gsl_vector* PCAModel::transform(const gsl_vector* input_v,
+        gsl_vector* projected_v) const {
+    if ((n_components <= 0) || (input_v == NULL) || (projected_v == NULL) ||
+            (input_v->size != n_inputs) || (projected_v->size != n_components))
+        return (NULL);
+    vector<double> centered(n_inputs);
+    for (int j = 0; j < n_inputs; j++)
+        centered[j] = gsl_vector_get(input_v, j) - gsl_vector_get(means_v, j);
+    for (int c = 0; c < n_components; c++)
+        gsl_vector_set(projected_v, c,
+                dot_product(gsl_matrix_const_ptr(components_m, c, 0),
+                    &centered[0], n_inputs));
+    return (projected_v);
+}
+
+
+// save -- Write the model to the named file.  Return false on error.
+
+bool PCAModel::save(const char* file_name) const {
+    PCAFileHeader header;
+
+    if (n_components <= 0)
+        return (false);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, pca_magic, sizeof(header.magic));
+    header.byte_order = pca_byte_order;
+    header.version = pca_file_version;
+    header.n_inputs = n_inputs;
+    header.n_components = n_components;
+
+    FILE* file = fopen(file_name, "wb");
+    if (file == NULL)
+        return (false);
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    for (int j = 0; ok && (j < n_inputs); j++) {
+        double value = gsl_vector_get(means_v, j);
+        ok = (fwrite(&value, sizeof(double), 1, file) == 1);
+    }
+    for (int c = 0; ok && (c < n_components); c++) {
+        double value = gsl_vector_get(eigenvalues_v, c);
+        ok = (fwrite(&value, sizeof(double), 1, file) == 1);
+    }
+    for (int c = 0; ok && (c < n_components); c++)
+        ok = (fwrite(gsl_matrix_const_ptr(components_m, c, 0), sizeof(double),
+                    n_inputs, file) == (size_t) n_inputs);
+    if (fclose(file) != 0)
+        ok = false;
+    return (ok);
+}
+
+
+// load -- Return a freshly allocated model read from the named file.
+//         Return NULL on error.
+
+PCAModel* PCAModel::load(const char* file_name) {
+    PCAFileHeader header;
+    struct stat file_stat;
+
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL)
+        return (NULL);
+    if ((fstat(fileno(file), &file_stat) != 0) ||
+            (fread(&header, sizeof(header), 1, file) != 1) ||
+            (memcmp(header.magic, pca_magic, sizeof(header.magic)) != 0) ||
+            (header.byte_order != pca_byte_order) ||
+            (header.version != pca_file_version) ||
+            (header.n_inputs == 0) || (header.n_inputs > INT_MAX) ||
+            (header.n_components == 0) ||
+            (header.n_components > header.n_inputs)) {
+        (void) fclose(file);
+        return (NULL);
+    }
+    // the file must hold exactly the means, the eigenvalues and the
+    // components, before any of them are allocated; with both counts below
+    // 2^31 the number of values cannot wrap, though its size in bytes could
+    uint64_t n_values = header.n_inputs +
+        (uint64_t) header.n_components * (1 + (uint64_t) header.n_inputs);
+    if ((n_values > (~(uint64_t) 0 - sizeof(header)) / sizeof(double)) ||
+            ((uint64_t) file_stat.st_size !=
+             sizeof(header) + n_values * sizeof(double))) {
+        (void) fclose(file);
+        return (NULL);
+    }
+    PCAModel* model = new PCAModel();
+    model->n_inputs = header.n_inputs;
+    model->means_v = gsl_vector_alloc(header.n_inputs);
+    model->eigenvalues_v = gsl_vector_alloc(header.n_components);
+    model->components_m = gsl_matrix_alloc(header.n_components,
+            header.n_inputs);
+    bool ok = model->means_v && model->eigenvalues_v && model->components_m;
+    for (int j = 0; ok && (j < model->n_inputs); j++) {
+        double value;
+        ok = (fread(&value, sizeof(double), 1, file) == 1);
+        gsl_vector_set(model->means_v, j, value);
+    }
+    for (int c = 0; ok && (c < (int) header.n_components); c++) {
+        double value;
+        ok = (fread(&value, sizeof(double), 1, file) == 1);
+        gsl_vector_set(model->eigenvalues_v, c, value);
+    }
+    for (int c = 0; ok && (c < (int) header.n_components); c++)
+        ok = (fread(gsl_matrix_ptr(model->components_m, c, 0), sizeof(double),
+                    model->n_inputs, file) == (size_t) model->n_inputs);
+    (void) fclose(file);
+    if (!ok) {
+        delete model;
+        return (NULL);
+    }
+    model->n_components = header.n_components;
+    return (model);
+}
@@ -0,0 +1,218 @@
+//
+// pca_model.h :  Specification file for a principal component analysis of
+//                the input vectors of a "pattern set" object, fitted once
+//                and then applied to other pattern sets and vectors.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef PCA_MODEL_INCLUDED
+#define PCA_MODEL_INCLUDED 1
+
+
+#include <vector>
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+#include "patterns.h"
+
+
+using namespace std;
+
+
+// covariance_matrix -- Fill "cov_m" with the covariance matrix of the rows
+//                      of "data_m", whose column means are given, summing
+//                      blocks of rows on "n_workers" threads.  Return
+//                      "cov_m", or NULL on error.
+gsl_matrix* covariance_matrix(gsl_matrix* cov_m, const gsl_matrix* data_m,
+        const gsl_vector* means_v, int n_workers = 1);
+
+
+//
+// CovarianceAccumulator Class  --  The count, mean and sum of centered outer
+//                                  products of a stream of input vectors,
+//                                  added a block of rows at a time, from
+//                                  which their covariance matrix follows.
+//                                  Only the accumulated sums are kept, so
+//                                  the vectors themselves need never all be
+//                                  in memory at once.  Accumulators of
+//                                  separate parts of the stream may be
+//                                  merged into one that covers them all,
+//                                  so each thread filling a part should
+//                                  have its own.
+//
+
+class CovarianceAccumulator {
+
+    private:
+
+        int n_inputs;             // number of values in each input vector
+        long n_rows;              // number of input vectors added so far
+        vector<double> means;     // the mean of each input value
+        gsl_matrix* sums_m;       // sum of the outer products of the input
+                                  // vectors less the means, lower triangle
+                                  // only
+        gsl_vector* block_means_v;  // scratch means of a block of rows
+        gsl_matrix* block_sums_m; // scratch sums of a block of rows
+
+        // accumulators are not copyable ...
+        CovarianceAccumulator(const CovarianceAccumulator&);
+        CovarianceAccumulator& operator=(const CovarianceAccumulator&);
+
+        // combine -- Fold the count, means and sums of another part of the
+        //            stream into this accumulator.
+        void combine(long other_rows, const double* other_means,
+                const gsl_matrix* other_sums_m);
+
+    public:
+
+        // Make an empty accumulator for input vectors of the given length.
+        // An accumulator whose storage could not be allocated has no
+        // inputs.
+        CovarianceAccumulator(int num_inputs);
+
+        ~CovarianceAccumulator();
+
+        // number_of_inputs -- Return the number of values in each input
+        //                     vector.
+        inline int number_of_inputs() const { return n_inputs; }
+
+        // number_of_rows -- Return the number of input vectors added.
+        inline long number_of_rows() const { return n_rows; }
+
+        // add -- Add the rows of the given matrix to the stream, summing
+        //        them with "n_workers" threads.  Return false on error.
+        bool add(const gsl_matrix* rows_m, int n_workers = 1);
+
+        // merge -- Add the input vectors that another accumulator has seen
+        //          to this one, as though they had been added here.  Return
+        //          false if the accumulators are for vectors of different
+        //          lengths.
+        bool merge(const CovarianceAccumulator& acc);
+
+        // mean_vector -- Copy the mean of each input value into the given
+        //                vector, returning a pointer to it.  Return NULL on
+        //                error.
+        gsl_vector* mean_vector(gsl_vector* means_v) const;
+
+        // covariance -- Fill the given matrix with the covariance matrix of
+        //               the input vectors added, returning a pointer to it.
+        //               Return NULL on error.
+        gsl_matrix* covariance(gsl_matrix* cov_m) const;
+
+};
+
+
+//
+// PCAModel Class  --  The principal component axes of a set of input
+//                     vectors: the mean of each input value, and the
+//                     leading eigenvectors of the covariance matrix with
+//                     their eigenvalues, largest first.  A model fitted to
+//                     training patterns projects testing patterns and
+//                     queries into the same reduced space, so that they
+//                     may be compared there.  Axes found by subspace
+//                     iteration (see below) are approximate: iteration
+//                     stops once their eigenvalues settle to about eight
+//                     significant digits, or after a fixed number of
+//                     steps, so the axes of nearly equal eigenvalues may
+//                     differ from those of a full decomposition.
+//
+
+class PCAModel {
+
+    private:
+
+        int n_inputs;             // number of values in each input vector
+        int n_components;         // number of principal axes kept
+
+        gsl_vector* means_v;      // the mean of each input value
+        gsl_matrix* components_m; // the principal axes, one per row, in
+                                  // order of decreasing eigenvalue
+        gsl_vector* eigenvalues_v;  // the variance along each axis
+
+        PCAModel();
+
+        // models are not copyable ...
+        PCAModel(const PCAModel&);
+        PCAModel& operator=(const PCAModel&);
+
+        // release -- Deallocate the means, axes and eigenvalues.
+        void release();
+
+        // fit -- Find the principal axes of the given covariance matrix, as
+        //        the constructors describe, given that "n_inputs" and
+        //        "means_v" are already set.  The covariance matrix is
+        //        destroyed.
+        void fit(gsl_matrix* cov_m, int n_components,
+                double variance_fraction);
+
+    public:
+
+        // Fit a model to the input vectors of the given pattern set.  At
+        // most "n_components" axes are kept (all of them if it is not
+        // positive), and no more than are needed to account for
+        // "variance_fraction" of the total variance.  A few leading axes
+        // are found by subspace iteration rather than a full
+        // eigendecomposition.  The covariance matrix is summed over blocks
+        // of patterns by "n_workers" threads.  A model that could not be
+        // fitted has no components.
+        PCAModel(const PatternSet& pset, int n_components = 0,
+                double variance_fraction = 1.0, int n_workers = 1);
+
+        // Fit a model to the input vectors that the given accumulator has
+        // seen, keeping axes as above.  This allows a model to be fitted to
+        // more patterns than fit in memory.
+        PCAModel(const CovarianceAccumulator& acc, int n_components = 0,
+                double variance_fraction = 1.0);
+
+        ~PCAModel();
+
+        // number_of_inputs -- Return the number of values in each input
+        //                     vector that the model applies to.
+        inline int number_of_inputs() const { return n_inputs; }
+
+        // number_of_components -- Return the number of principal axes kept,
+        //                         which is the number of values in each
+        //                         projected vector, or zero if the model
+        //                         could not be fitted.
+        inline int number_of_components() const { return n_components; }
+
+        // means -- Return the mean of each input value.
+        inline const gsl_vector* means() const { return means_v; }
+
+        // components -- Return the principal axes, one per row, in order of
+        //               decreasing eigenvalue.
+        inline const gsl_matrix* components() const { return components_m; }
+
+        // eigenvalues -- Return the variance along each principal axis.
+        inline const gsl_vector* eigenvalues() const { return eigenvalues_v; }
+
+        // transform -- Project each row of "inputs_m", less the means, onto
+        //              the principal axes, writing the result to the
+        //              matching row of "projected_m", which must have a
+        //              column for each component.  Rows are centered a
+        //              block at a time, and each block is projected with a
+        //              single matrix multiply.  Return false on error.
+        bool transform(const gsl_matrix* inputs_m,
+                gsl_matrix* projected_m) const;
+
+        // transform -- Project the given input vector onto the principal
+        //              axes, writing the result to "projected_v",
+        //              returning a pointer to it.  Return NULL on error.
+        gsl_vector* transform(const gsl_vector* input_v,
+                gsl_vector* projected_v) const;
+
+        // save -- Write the model to the named file.  Return false on
+        //         error.
+        bool save(const char* file_name) const;
+
+        // load -- Return a freshly allocated model read from the named file.
+        //         Return NULL on error.
+        static PCAModel* load(const char* file_name);
+
+};
+
+
+
+#endif  // #ifndef PCA_MODEL_INCLUDED
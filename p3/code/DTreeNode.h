@@ -5,23 +5,34 @@
  *
  */
 
+#ifndef DTREENODE_INCLUDED
+#define DTREENODE_INCLUDED 1
+
 #include <list>
+
+#include "patterns.h"
+#include "bit_columns.h"
 using namespace std;
 
 typedef struct attribute {
     int index;
     double gain;
     int num_attribute;
+    double threshold; //examples with a value >= threshold have the attribute. 0.5 for binary attributes
+    bool continuous; //split at a threshold found from the data rather than treated as binary
 } attribute;
 
 typedef struct decisionTreeNode {
     list<attribute> attributes;
     attribute decision;
-    int* example_indexes;
+    int* example_indexes; //NULL for trees built from sorted columns, which keep their examples there
     int num_examples;
     int num_positive;
     int label;
     PatternSet* pset;
+    BitColumns* columns; //packed copy of pset for counting, or NULL to read pset directly
     decisionTreeNode* childP;
     decisionTreeNode* childN;
 } DTreeNode;
+
+#endif
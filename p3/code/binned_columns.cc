@@ -0,0 +1,144 @@
+//
+// binned_columns.cc :  Implementation file for the input attributes of a
+//                      "pattern set" object quantized into a small number
+//                      of bins.
+//
+
+
+#include <vector>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include <gsl/gsl_vector.h>
+
+#include "patterns.h"
+#include "binned_columns.h"
+
+
+// choose_cuts -- Append to "cuts" the lowest value of each bin after the
+//                first for the given values, which are sorted in place,
+//                using at most "num_bins" bins.  Every distinct value gets
+//                a bin of its own if there are few enough of them;
+//                otherwise each bin is closed once it holds its share of
+//                the values.  Return the number of bins.
+static int choose_cuts(vector<double>& sorted, int num_bins,
+        vector<double>& cuts) {
+    int n = sorted.size();
+    int n_distinct = 0;
+    int bins = 1;
+
+    sort(sorted.begin(), sorted.end());
+    for (int k = 0; k < n; k++)
+        n_distinct += (k == 0) || (sorted[k] != sorted[k - 1]);
+    double share = (n_distinct <= num_bins) ? 0.0 : (double) n / num_bins;
+    int in_bin = 0;
+    for (int k = 0; k < n - 1; k++) {
+        in_bin++;
+        if ((sorted[k] == sorted[k + 1]) || (in_bin < share))
+            continue;
+        if (bins == num_bins)
+            break;
+        // cut halfway between neighboring values, where there is room ...
+        double cut = sorted[k] + (sorted[k + 1] - sorted[k]) / 2;
+        if (cut <= sorted[k])
+            cut = sorted[k + 1];
+        cuts.push_back(cut);
+        bins++;
+        in_bin = 0;
+    }
+    return (bins);
+}
+
+
+//
+// BinnedColumns Class  --  Member function implementations
+//
+
+// constructor
+
+BinnedColumns::BinnedColumns() {
+    n_examples = 0;
+    n_attributes = 0;
+    offsets.assign(1, 0);
+}
+
+
+// build -- Fill the columns from the given pattern set, quantizing each
+//          attribute into at most "num_bins" bins, replacing any previous
+//          contents.  The label is the last target value, thresholded at
+//          0.5.  Return false on error.
+
+bool BinnedColumns::build(const PatternSet& pset, int num_bins) {
+    int num_examples = pset.number_of_patterns();
+    int num_attributes = pset.number_of_inputs();
+    int size = pset.pattern_size();
+
+    if ((num_examples <= 0) || (num_attributes <= 0) ||
+            (pset.number_of_targets() <= 0) ||
+            (num_bins < 2) || (num_bins > max_bins))
+        return (false);
+    gsl_vector* curr = gsl_vector_alloc(size);
+    if (curr == NULL)
+        return (false);
+    n_examples = num_examples;
+    n_attributes = num_attributes;
+    // transpose the patterns into columns of values ...
+    vector<double> values((size_t) n_attributes * n_examples);
+    labels.resize(n_examples);
+    for (int i = 0; i < n_examples; i++) {
+        pset.full_pattern(i, curr);
+        for (int a = 0; a < n_attributes; a++)
+            values[(size_t) a * n_examples + i] = gsl_vector_get(curr, a);
+        labels[i] = (gsl_vector_get(curr, size - 1) >= 0.5);
+    }
+    gsl_vector_free(curr);
+    // ... and replace them with their bins, one attribute at a time
+    codes.resize((size_t) n_attributes * n_examples);
+    n_bins.resize(n_attributes);
+    offsets.resize(n_attributes + 1);
+    cuts.clear();
+    vector<double> sorted(n_examples);
+    for (int a = 0; a < n_attributes; a++) {
+        const double* column = &values[0] + (size_t) a * n_examples;
+        offsets[a] = cuts.size() + a;
+        sorted.assign(column, column + n_examples);
+        n_bins[a] = choose_cuts(sorted, num_bins, cuts);
+        vector<double>::iterator first = cuts.begin() + offsets[a] - a;
+        for (int i = 0; i < n_examples; i++)
+            codes[(size_t) a * n_examples + i] = (uint8_t)
+                (upper_bound(first, cuts.end(), column[i]) - first);
+    }
+    offsets[n_attributes] = cuts.size() + n_attributes;
+    return (true);
+}
+
+
+// fill_histogram -- Fill "hist", of "histogram_size()" counts, with the
+//                   histogram of the given examples.
+
+void BinnedColumns::fill_histogram(const int* example_indexes,
+        int num_examples, int* hist) const {
+    fill(hist, hist + histogram_size(), 0);
+    for (int a = 0; a < n_attributes; a++) {
+        const uint8_t* column = &codes[0] + (size_t) a * n_examples;
+        int* counts = hist + 2 * offsets[a];
+        int* positives = counts + n_bins[a];
+        for (int k = 0; k < num_examples; k++) {
+            int i = example_indexes[k];
+            counts[column[i]]++;
+            positives[column[i]] += labels[i];
+        }
+    }
+}
+
+
+// subtract_histogram -- Take the histogram "part" away from "hist", leaving
+//                       the histogram of the other examples.
+
+void BinnedColumns::subtract_histogram(int* hist, const int* part) const {
+    int size = histogram_size();
+
+    for (int c = 0; c < size; c++)
+        hist[c] -= part[c];
+}
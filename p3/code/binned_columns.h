@@ -0,0 +1,116 @@
+//
+// binned_columns.h :  Specification file for the input attributes of a
+//                     "pattern set" object quantized into a small number of
+//                     bins, for histogram based decision tree training.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef BINNED_COLUMNS_INCLUDED
+#define BINNED_COLUMNS_INCLUDED 1
+
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "patterns.h"
+
+
+using namespace std;
+
+
+// max_bins -- The most bins an attribute may be quantized into, so that
+//             every bin code fits in a byte.
+const int max_bins = 256;
+
+
+//
+// BinnedColumns Class  --  The input attributes of a set of training
+//                          examples, each quantized once into at most 256
+//                          bins and stored as a column of one byte codes.
+//                          An attribute with few enough distinct values gets
+//                          a bin for each; otherwise the bins hold roughly
+//                          equal numbers of examples.  The statistics of a
+//                          set of examples are a histogram, giving for every
+//                          bin of every attribute the number of examples
+//                          and the number with a positive label, and the
+//                          best threshold for an attribute is found by
+//                          scanning its bins rather than its examples.
+//                          Since histograms add, a child node's histogram
+//                          is its parent's less its sibling's, so only the
+//                          smaller child of each split needs to be counted.
+//
+
+class BinnedColumns {
+
+    private:
+
+        int n_examples;           // number of examples
+        int n_attributes;         // number of input attributes
+        vector<uint8_t> codes;    // the bin of each value, one column after
+                                  // another
+        vector<char> labels;      // the label of each example
+        vector<int> n_bins;       // number of bins of each attribute
+        vector<int> offsets;      // number of bins of all the attributes
+                                  // before each one
+        vector<double> cuts;      // for each attribute, the lowest value of
+                                  // each bin after the first, starting at
+                                  // its offset less its own index
+
+    public:
+
+        BinnedColumns();
+
+        // build -- Fill the columns from the given pattern set, quantizing
+        //          each attribute into at most "num_bins" bins, replacing
+        //          any previous contents.  The label is the last target
+        //          value, thresholded at 0.5.  Return false on error.
+        bool build(const PatternSet& pset, int num_bins = max_bins);
+
+        // number_of_examples -- Return the number of examples stored.
+        inline int number_of_examples() const { return n_examples; }
+
+        // number_of_attributes -- Return the number of input attributes.
+        inline int number_of_attributes() const { return n_attributes; }
+
+        // number_of_bins -- Return the number of bins of the "a"th attribute.
+        inline int number_of_bins(int a) const { return n_bins[a]; }
+
+        // code -- Return the bin of the "a"th attribute of the "i"th example.
+        inline int code(int a, int i) const
+            { return (codes[(size_t) a * n_examples + i]); }
+
+        // label -- Return the label of the "i"th example.
+        inline bool label(int i) const { return (labels[i] != 0); }
+
+        // cut -- Return the lowest value of the "a"th attribute that falls in
+        //        bin "b" or above, for "b" from 1 up.
+        inline double cut(int a, int b) const
+            { return (cuts[offsets[a] - a + b - 1]); }
+
+        // histogram_size -- Return the number of counts in a histogram, two
+        //                   for every bin of every attribute.
+        inline int histogram_size() const
+            { return (2 * offsets[n_attributes]); }
+
+        // bin_counts -- Return the start of the "a"th attribute's part of the
+        //               given histogram: the number of examples in each bin
+        //               followed by the number with a positive label.
+        inline const int* bin_counts(const int* hist, int a) const
+            { return (hist + 2 * offsets[a]); }
+
+        // fill_histogram -- Fill "hist", of "histogram_size()" counts, with
+        //                   the histogram of the given examples.
+        void fill_histogram(const int* example_indexes, int num_examples,
+                int* hist) const;
+
+        // subtract_histogram -- Take the histogram "part" away from "hist",
+        //                       leaving the histogram of the other examples.
+        void subtract_histogram(int* hist, const int* part) const;
+
+};
+
+
+
+#endif  // #ifndef BINNED_COLUMNS_INCLUDED
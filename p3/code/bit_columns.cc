@@ -0,0 +1,89 @@
+//
+// bit_columns.cc :  Implementation file for column-wise, bit-packed storage
+//                   of the binary attributes of a "pattern set" object.
+//
+
+
+#include <vector>
+
+#include <stdint.h>
+
+#include <gsl/gsl_vector.h>
+
+#include "patterns.h"
+#include "bit_columns.h"
+
+
+//
+// BitColumns Class  --  Member function implementations
+//
+
+// constructor
+
+BitColumns::BitColumns() {
+    n_examples = 0;
+    n_attributes = 0;
+    n_words = 0;
+}
+
+
+// build -- Fill the columns from the given pattern set, replacing any
+//          previous contents.  Return false on error.
+
+bool BitColumns::build(const PatternSet& pset) {
+    int num_examples = pset.number_of_patterns();
+    int num_attributes = pset.number_of_inputs();
+    int size = pset.pattern_size();
+
+    if ((num_examples <= 0) || (num_attributes < 0) ||
+            (pset.number_of_targets() <= 0))
+        return (false);
+    gsl_vector* curr = gsl_vector_alloc(size);
+    if (curr == NULL)
+        return (false);
+    n_examples = num_examples;
+    n_attributes = num_attributes;
+    n_words = (n_examples + bits_per_word - 1) / bits_per_word;
+    bits.assign((size_t) (n_attributes + 1) * n_words, 0);
+    // each pattern is read once, setting its bit in every column ...
+    for (int i = 0; i < n_examples; i++) {
+        pset.full_pattern(i, curr);
+        uint64_t bit = (uint64_t) 1 << (i % bits_per_word);
+        uint64_t* word = &bits[0] + i / bits_per_word;
+        for (int a = 0; a <= n_attributes; a++) {
+            // the label is the last value of the pattern ...
+            double value = gsl_vector_get(curr, (a < n_attributes) ? a :
+                    size - 1);
+            if (value >= 0.5)
+                word[a * n_words] |= bit;
+        }
+    }
+    gsl_vector_free(curr);
+    return (true);
+}
+
+
+// fill_mask -- Fill "mask", which must hold "words_per_column()" words, with
+//              the set of the given examples.
+
+void BitColumns::fill_mask(const int* example_indexes, int num_examples,
+        uint64_t* mask) const {
+    for (int w = 0; w < n_words; w++)
+        mask[w] = 0;
+    for (int k = 0; k < num_examples; k++) {
+        int i = example_indexes[k];
+        mask[i / bits_per_word] |= (uint64_t) 1 << (i % bits_per_word);
+    }
+}
+
+
+// count_mask -- Return the number of examples in the given mask that also
+//               belong to the given column.
+
+int BitColumns::count_mask(const uint64_t* mask, const uint64_t* col) const {
+    int count = 0;
+
+    for (int w = 0; w < n_words; w++)
+        count += count_bits(mask[w] & col[w]);
+    return (count);
+}
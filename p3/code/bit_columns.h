@@ -0,0 +1,110 @@
+//
+// bit_columns.h :  Specification file for column-wise, bit-packed storage
+//                  of the binary attributes of a "pattern set" object, for
+//                  use in decision tree training.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef BIT_COLUMNS_INCLUDED
+#define BIT_COLUMNS_INCLUDED 1
+
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "patterns.h"
+
+
+using namespace std;
+
+
+// bits_per_word -- The number of examples packed into each word of a column.
+const int bits_per_word = 64;
+
+// count_bits -- Return the number of bits set in the given word.
+inline int count_bits(uint64_t word) {
+#ifdef __GNUC__
+    return (__builtin_popcountll(word));
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return ((int) ((word * 0x0101010101010101ULL) >> 56));
+#endif
+}
+
+
+//
+// BitColumns Class  --  The input attributes of a set of training examples,
+//                       each thresholded at 0.5 and stored as a column of
+//                       bits, one per example, with the label (the last
+//                       target value) as one more column.  Subsets of the
+//                       examples are given as masks of the same layout, so
+//                       counting the examples in a subset that have an
+//                       attribute, a positive label, or both, comes down to
+//                       ANDing words and counting their bits.
+//
+
+class BitColumns {
+
+    private:
+
+        int n_examples;           // number of examples
+        int n_attributes;         // number of input attributes
+        int n_words;              // number of words in each column
+        vector<uint64_t> bits;    // the columns, one after another, with
+                                  // the labels last
+
+    public:
+
+        BitColumns();
+
+        // build -- Fill the columns from the given pattern set, replacing
+        //          any previous contents.  Return false on error.
+        bool build(const PatternSet& pset);
+
+        // number_of_examples -- Return the number of examples stored.
+        inline int number_of_examples() const { return n_examples; }
+
+        // number_of_attributes -- Return the number of input attributes.
+        inline int number_of_attributes() const { return n_attributes; }
+
+        // words_per_column -- Return the number of words in each column, and
+        //                     so in each example mask.
+        inline int words_per_column() const { return n_words; }
+
+        // column -- Return the bits of the "a"th attribute.
+        inline const uint64_t* column(int a) const
+            { return (&bits[0] + a * n_words); }
+
+        // labels -- Return the bits of the labels.
+        inline const uint64_t* labels() const
+            { return (&bits[0] + n_attributes * n_words); }
+
+        // has_attribute -- Return true if the "i"th example has the "a"th
+        //                  attribute.
+        inline bool has_attribute(int a, int i) const
+            { return ((column(a)[i / bits_per_word] >>
+                        (i % bits_per_word)) & 1); }
+
+        // has_label -- Return true if the "i"th example has a positive
+        //              label.
+        inline bool has_label(int i) const
+            { return ((labels()[i / bits_per_word] >> (i % bits_per_word)) & 1); }
+
+        // fill_mask -- Fill "mask", which must hold "words_per_column()"
+        //              words, with the set of the given examples.
+        void fill_mask(const int* example_indexes, int num_examples,
+                uint64_t* mask) const;
+
+        // count_mask -- Return the number of examples in the given mask that
+        //               also belong to the given column.
+        int count_mask(const uint64_t* mask, const uint64_t* col) const;
+
+};
+
+
+
+#endif  // #ifndef BIT_COLUMNS_INCLUDED
@@ -0,0 +1,313 @@
+//
+// flat_tree.cc :  Implementation file for a trained decision tree compiled
+//                 into a flat array of small nodes, and saved to or mapped
+//                 from a binary model file.
+//
+
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+
+#include <gsl/gsl_vector.h>
+
+#include "DTreeNode.h"
+#include "flat_tree.h"
+
+
+// FlatTreeHeader -- The header at the start of a model file, followed by
+//                   the nodes exactly as they are held in memory.
+struct FlatTreeHeader {
+    char magic[8];            // identifies the file format
+    uint32_t byte_order;      // "model_byte_order", as written
+    uint32_t version;         // format version
+    uint32_t n_inputs;        // number of input values in a pattern
+    uint32_t n_nodes;         // number of nodes
+    uint64_t nodes_offset;    // file offset of the nodes
+};
+
+// the first bytes of every model file ...
+static const char model_magic[8] = { 'D', 'T', 'R', 'E', 'E', 'F', 'L', '\0' };
+
+// a value that reads differently under the other byte order ...
+static const uint32_t model_byte_order = 0x01020304;
+
+// the version written, and the only one read ...
+static const uint32_t model_version = 1;
+
+
+// PendingBranch -- A branch of the tree waiting to be compiled: the node
+//                  under it (NULL for a missing branch), its parent, and
+//                  the compiled node whose right hand child it is, or -1
+//                  for a left hand child.
+struct PendingBranch {
+    const DTreeNode* node;
+    const DTreeNode* parent;
+    int right_of;
+};
+
+
+//
+// FlatTree Class  --  Member function implementations
+//
+
+// constructor
+
+FlatTree::FlatTree() {
+    flat = NULL;
+    n_nodes = 0;
+    n_inputs = 0;
+    mapping = NULL;
+    mapping_length = 0;
+}
+
+
+// destructor
+
+FlatTree::~FlatTree() {
+    release();
+}
+
+
+// release -- Drop the nodes, unmapping any model file.
+
+void FlatTree::release() {
+    if (mapping)
+        (void) munmap(mapping, mapping_length);
+    mapping = NULL;
+    mapping_length = 0;
+    nodes.clear();
+    flat = NULL;
+    n_nodes = 0;
+    n_inputs = 0;
+}
+
+
+// compile -- Replace this tree with a flattened copy of the tree under
+//            "root".  Return false on error.
+
+bool FlatTree::compile(const DTreeNode* root) {
+    release();
+    if (root == NULL)
+        return (false);
+    // trees of continuous splits may be far deeper than the call stack
+    // allows, so branches wait on a stack of their own, the right hand
+    // branch of a node beneath the left so that it is laid out after the
+    // whole left hand subtree ...
+    vector<PendingBranch> pending;
+    PendingBranch branch = { root, NULL, -1 };
+    pending.push_back(branch);
+    while (!pending.empty()) {
+        branch = pending.back();
+        pending.pop_back();
+        if (branch.right_of >= 0)
+            nodes[branch.right_of].right = nodes.size();
+        int n = compile_node(branch.node, branch.parent);
+        if (nodes[n].feature >= 0) {
+            PendingBranch right = { branch.node->childP, branch.node, n };
+            PendingBranch left = { branch.node->childN, branch.node, -1 };
+            pending.push_back(right);
+            pending.push_back(left);
+        }
+    }
+    flat = &nodes[0];
+    n_nodes = nodes.size();
+    // the tree applies to the patterns it was trained on, which have at
+    // least the inputs that it tests ...
+    n_inputs = root->pset ? root->pset->number_of_inputs() : 0;
+    for (int n = 0; n < n_nodes; n++)
+        if (flat[n].feature >= n_inputs)
+            n_inputs = flat[n].feature + 1;
+    return (true);
+}
+
+
+// compile_node -- Append the given node, which may be NULL for a missing
+//                 branch of "parent", without its children.  The right
+//                 hand child of a decision is left for the caller to fill
+//                 in.  Return the index of the new node.
+
+int FlatTree::compile_node(const DTreeNode* node, const DTreeNode* parent) {
+    int n = nodes.size();
+
+    nodes.push_back(FlatNode());
+    if ((node == NULL) || (node->label >= 0)) {
+        // a leaf, taking the majority of the parent for a missing branch ...
+        nodes[n].threshold = 0.0;
+        nodes[n].feature = -1;
+        nodes[n].right = node ? node->label :
+            (2 * parent->num_positive >= parent->num_examples);
+        return (n);
+    }
+    nodes[n].threshold = node->decision.threshold;
+    nodes[n].feature = node->decision.index;
+    nodes[n].right = 0;
+    return (n);
+}
+
+
+// classify -- Return the label of the given input vector.
+
+int FlatTree::classify(const gsl_vector* pattern) const {
+    int n = 0;
+
+    while (flat[n].feature >= 0)
+        n = (gsl_vector_get(pattern, flat[n].feature) >= flat[n].threshold) ?
+            flat[n].right : n + 1;
+    return (flat[n].right);
+}
+
+
+// classify_batch -- Write the labels of "n_rows" patterns to "labels", the
+//                   "r"th pattern starting at "rows + r * stride", moving
+//                   "batch_rows" patterns through the tree a level at a
+//                   time.
+
+void FlatTree::classify_batch(const double* rows, int n_rows, int stride,
+        int* labels) const {
+    int at[batch_rows];           // node reached by each active pattern
+    int active[batch_rows];       // the patterns not yet at a leaf
+
+    for (int first = 0; first < n_rows; first += batch_rows) {
+        int n_active = n_rows - first;
+        if (n_active > batch_rows)
+            n_active = batch_rows;
+        for (int r = 0; r < n_active; r++) {
+            at[r] = 0;
+            active[r] = r;
+        }
+        // take every active pattern down one level, dropping those that
+        // reach a leaf ...
+        while (n_active > 0) {
+            int still_active = 0;
+            for (int k = 0; k < n_active; k++) {
+                int r = active[k];
+                const FlatNode& curr = flat[at[r]];
+                if (curr.feature < 0) {
+                    labels[first + r] = curr.right;
+                    continue;
+                }
+                const double* x = rows + (size_t) (first + r) * stride;
+                at[r] = (x[curr.feature] >= curr.threshold) ? curr.right :
+                    at[r] + 1;
+                active[still_active++] = r;
+            }
+            n_active = still_active;
+        }
+    }
+}
+
+
+// save -- Write the tree to a temporary file beside the named model file
+//         and rename it into place, so that a process which has the old
+//         file mapped keeps its nodes rather than seeing the file cut
+//         short under it.  Return false on error.
+
+bool FlatTree::save(const char* file_name) const {
+    FlatTreeHeader header;
+
+    if (n_nodes <= 0)
+        return (false);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, model_magic, sizeof(header.magic));
+    header.byte_order = model_byte_order;
+    header.version = model_version;
+    header.n_inputs = n_inputs;
+    header.n_nodes = n_nodes;
+    header.nodes_offset = sizeof(header);
+
+    string temp_name = string(file_name) + ".XXXXXX";
+    vector<char> temp_buffer(temp_name.begin(), temp_name.end());
+    temp_buffer.push_back('\0');
+    int fd = mkstemp(&temp_buffer[0]);
+    if (fd < 0)
+        return (false);
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL) {
+        (void) close(fd);
+        (void) unlink(&temp_buffer[0]);
+        return (false);
+    }
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(flat, sizeof(FlatNode), n_nodes, file) == (size_t) n_nodes) &&
+        (fflush(file) == 0) && (fsync(fd) == 0);
+    // a model file is as readable as any other new file, rather than
+    // private to its owner as "mkstemp" leaves it ...
+    mode_t mask = umask(0);
+    (void) umask(mask);
+    if (fchmod(fd, 0666 & ~mask) != 0)
+        ok = false;
+    if (fclose(file) != 0)
+        ok = false;
+    if (ok && (rename(&temp_buffer[0], file_name) != 0))
+        ok = false;
+    if (!ok)
+        (void) unlink(&temp_buffer[0]);
+    return (ok);
+}
+
+
+// load -- Replace this tree with the one in the named model file, mapping
+//         the file into memory rather than reading it.  Return false on
+//         error, leaving no tree.
+
+bool FlatTree::load(const char* file_name) {
+    struct stat file_stat;
+    FlatTreeHeader header;
+
+    release();
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return (false);
+    if ((fstat(fd, &file_stat) != 0) ||
+            ((size_t) file_stat.st_size < sizeof(header))) {
+        (void) close(fd);
+        return (false);
+    }
+    size_t length = (size_t) file_stat.st_size;
+    void* mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    (void) close(fd);
+    if (mapped == MAP_FAILED)
+        return (false);
+    memcpy(&header, mapped, sizeof(header));
+    bool valid = (memcmp(header.magic, model_magic, sizeof(header.magic)) == 0)
+        && (header.byte_order == model_byte_order) &&
+        (header.version == model_version) &&
+        (header.n_inputs <= 0x7fffffff) &&
+        (header.n_nodes > 0) && (header.n_nodes <= 0x7fffffff) &&
+        (header.nodes_offset >= sizeof(header)) &&
+        (header.nodes_offset % sizeof(double) == 0) &&
+        (header.nodes_offset <= length) &&
+        (header.n_nodes <= (length - header.nodes_offset) / sizeof(FlatNode));
+    const FlatNode* file_nodes = valid ?
+        (const FlatNode*) ((const char*) mapped + header.nodes_offset) : NULL;
+    // every child must come later in the array, so a walk always ends ...
+    int num_nodes = (int) header.n_nodes;
+    for (int n = 0; valid && (n < num_nodes); n++) {
+        const FlatNode& curr = file_nodes[n];
+        if (curr.feature < 0)
+            valid = (curr.feature == -1) &&
+                ((curr.right == 0) || (curr.right == 1));
+        else
+            valid = (curr.feature < (int) header.n_inputs) &&
+                (n + 1 < num_nodes) && (curr.right > n + 1) &&
+                (curr.right < num_nodes);
+    }
+    if (!valid) {
+        (void) munmap(mapped, length);
+        return (false);
+    }
+    mapping = mapped;
+    mapping_length = length;
+    flat = file_nodes;
+    n_nodes = num_nodes;
+    n_inputs = (int) header.n_inputs;
+    return (true);
+}
@@ -0,0 +1,136 @@
+//
+// flat_tree.h :  Specification file for a trained decision tree compiled
+//                into a flat array of small nodes for fast classification,
+//                and saved to or mapped from a binary model file.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef FLAT_TREE_INCLUDED
+#define FLAT_TREE_INCLUDED 1
+
+
+#include <vector>
+
+#include <gsl/gsl_vector.h>
+
+#include "DTreeNode.h"
+
+
+using namespace std;
+
+
+// FlatNode -- One node of a flattened tree.  An inner node sends a pattern
+//             whose "feature"th value is at least "threshold" to the node
+//             numbered "right", and any other pattern to the node just
+//             after it.  A leaf has a negative "feature" and keeps its
+//             label in "right".
+struct FlatNode {
+    double threshold;         // least value on the right hand side
+    int feature;              // input value tested, or -1 for a leaf
+    int right;                // right hand child, or the label of a leaf
+};
+
+
+//
+// FlatTree Class  --  A decision tree laid out in one contiguous array of
+//                     16 byte nodes in depth first order, so that the left
+//                     hand child of each node is the next node.  Patterns
+//                     are classified by a loop over the array rather than
+//                     by recursion through the much larger "DTreeNode"
+//                     structures.  A branch that no training example took
+//                     is compiled into a leaf with the majority label of
+//                     its parent.  The array is also the model file
+//                     format, so a saved tree is loaded by mapping the
+//                     file and using its nodes where they lie.
+//
+
+class FlatTree {
+
+    private:
+
+        const FlatNode* flat;     // the nodes, the root first
+        int n_nodes;              // number of nodes
+        int n_inputs;             // number of input values in a pattern
+
+        vector<FlatNode> nodes;   // the nodes of a compiled tree
+        void* mapping;            // the mapped model file of a loaded tree
+        size_t mapping_length;    // length of the mapping
+
+        // trees are not copyable ...
+        FlatTree(const FlatTree&);
+        FlatTree& operator=(const FlatTree&);
+
+        // release -- Drop the nodes, unmapping any model file.
+        void release();
+
+        // compile_node -- Append the given node, which may be NULL for a
+        //                 missing branch of "parent", without its children.
+        //                 Return the index of the new node.
+        int compile_node(const DTreeNode* node, const DTreeNode* parent);
+
+    public:
+
+        // number of patterns that "classify_batch" moves through the tree
+        // together
+        static const int batch_rows = 256;
+
+        FlatTree();
+
+        ~FlatTree();
+
+        // compile -- Replace this tree with a flattened copy of the tree
+        //            under "root".  Return false on error.
+        bool compile(const DTreeNode* root);
+
+        // number_of_nodes -- Return the number of nodes in the tree, or zero
+        //                    if there is no tree.
+        inline int number_of_nodes() const { return n_nodes; }
+
+        // number_of_inputs -- Return the number of input values in each
+        //                     pattern that the tree classifies.
+        inline int number_of_inputs() const { return n_inputs; }
+
+        // node -- Return the "n"th node.
+        inline const FlatNode& node(int n) const { return flat[n]; }
+
+        // classify -- Return the label of the given input values.
+        inline int classify(const double* x) const {
+            int n = 0;
+            while (flat[n].feature >= 0)
+                n = (x[flat[n].feature] >= flat[n].threshold) ?
+                    flat[n].right : n + 1;
+            return (flat[n].right);
+        }
+
+        // classify -- Return the label of the given input vector.
+        int classify(const gsl_vector* pattern) const;
+
+        // classify_batch -- Write the labels of "n_rows" patterns to
+        //                   "labels", the "r"th pattern starting at
+        //                   "rows + r * stride".  The patterns go through the
+        //                   tree "batch_rows" at a time and one level at a
+        //                   time, so that the memory reads of different
+        //                   patterns overlap instead of each one waiting on
+        //                   the last.
+        void classify_batch(const double* rows, int n_rows, int stride,
+                int* labels) const;
+
+        // save -- Write the tree to the named model file.  The file is
+        //         replaced by renaming a new one over it, never rewritten in
+        //         place, so trees already loaded from it are unaffected.
+        //         Return false on error.
+        bool save(const char* file_name) const;
+
+        // load -- Replace this tree with the one in the named model file,
+        //         mapping the file into memory rather than reading it.  The
+        //         nodes are checked so that no file can make "classify" read
+        //         outside the tree or loop.  Return false on error, leaving
+        //         no tree.
+        bool load(const char* file_name);
+
+};
+
+
+
+#endif  // #ifndef FLAT_TREE_INCLUDED
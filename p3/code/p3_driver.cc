@@ -19,10 +19,17 @@
 #include <string>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include <gsl/gsl_vector.h>
 
 #include "patterns.h"
+#include "bit_columns.h"
+#include "task_pool.h"
+#include "sorted_columns.h"
+#include "binned_columns.h"
+#include "flat_tree.h"
 #include "DTreeNode.h" //data structures for my decision tree. I probably could reimplement it in a proper class format but I chose to do it procedurally because It is more natural / easier. Requires less planning. 
 
 
@@ -42,10 +49,22 @@ string& trim(string& s) {
     return (s);
 }
 
+//limits on the trees built from continuous splits, whose depth isn't bounded by the number of
+//attributes. A max_depth of 0 means no limit, and min_leaf is the fewest examples either side
+//of a split may have
+struct TreeLimits {
+    int max_depth;
+    int min_leaf;
+};
+
 //headers for functions that I declared below main but wanted to call in main.
 void ID3(DTreeNode* node);
+void ID3_parallel(DTreeNode* root, int num_threads);
+void ID3_sorted(DTreeNode* root, SortedColumns& columns, const TreeLimits& limits);
+void ID3_histogram(DTreeNode* root, const BinnedColumns& columns, int* examples, vector<int>& root_hist, const TreeLimits& limits);
 void printDT(DTreeNode* root, int depth);
 int classify_pattern(DTreeNode* Root, gsl_vector* pattern); 
+int score_patterns(const char* program, const FlatTree& flat_tree, int input_dimensionality, int num_testing, string testing_file_name, string output_file_name);
 
 //
 // Main Driver Program
@@ -53,7 +72,6 @@ int classify_pattern(DTreeNode* Root, gsl_vector* pattern);
 
 int main(int argc, char** argv) {
     PatternSet* pset;
-    PatternSet* testingpset;
     ifstream config_file_str;
     ifstream input_file_str;
     int input_dimensionality;
@@ -81,6 +99,41 @@ int main(int argc, char** argv) {
     config_file_str >> num_testing;
     config_file_str >> testing_file_name;
     config_file_str >> output_file_name;
+    //optional number of threads to build the tree with. Older config files leave it out and get
+    //the single threaded ID3 with its progress printout
+    int num_threads;
+    if(!(config_file_str >> num_threads) || num_threads < 1)
+        num_threads = 1;
+    //optional way of splitting nodes. Binary is plain ID3 on attributes thresholded at 0.5,
+    //Sorted finds the best threshold of each continuous attribute from presorted columns,
+    //Histogram finds it among the edges of at most 256 bins per attribute
+    string split_method;
+    if(!(config_file_str >> split_method))
+        split_method = "Binary";
+    //optional binary model file. A trained tree is saved there, and with no training patterns
+    //the tree is loaded from it instead, so scoring doesn't have to wait on training. A model
+    //file of "-" means none, so that the limits below can be given without one
+    string model_file_name;
+    bool has_model_file = false;
+    if(config_file_str >> model_file_name)
+        has_model_file = (trim(model_file_name) != "-");
+    //optional limits on the Sorted and Histogram trees, the greatest depth of a node (0 for no
+    //limit) and the fewest examples on either side of a split
+    TreeLimits limits;
+    if(!(config_file_str >> limits.max_depth) || limits.max_depth < 0)
+        limits.max_depth = 0;
+    if(!(config_file_str >> limits.min_leaf) || limits.min_leaf < 1)
+        limits.min_leaf = 1;
+
+    if(num_training <= 0) {
+        FlatTree model;
+        if(!has_model_file || !model.load(trim(model_file_name).c_str()) ||
+                model.number_of_inputs() > input_dimensionality) {
+            cerr << argv[0] << " error:  cannot load the model file." << endl;
+            return (-1);
+        }
+        return score_patterns(argv[0], model, input_dimensionality, num_testing, testing_file_name, output_file_name);
+    }
 
     // Make pattern set ...
     pset = new PatternSet(num_training, input_dimensionality, 1);
@@ -99,10 +152,20 @@ int main(int argc, char** argv) {
     if (input_file_str.is_open())
         input_file_str.close();
 
+    //pack the attributes into bit columns once so the gains can be counted a word at a time
+    BitColumns columns;
+    //or sort each attribute once, for continuous splits
+    SortedColumns sorted_columns;
+    bool sorted = (split_method[0] == 'S');
+    //or quantize each attribute once, for continuous splits from histograms
+    BinnedColumns binned_columns;
+    bool binned = (split_method[0] == 'H');
+
     //create decision learning tree
     //create a root node fot the tree
     DTreeNode Root;
     Root.pset = pset;
+    Root.columns = (!sorted && !binned && columns.build(*pset)) ? &columns : NULL;
     Root.example_indexes = new int[num_training];
     Root.num_examples = num_training;
     for(int i = 0; i < num_training; i++) //fill out index list
@@ -111,22 +174,58 @@ int main(int argc, char** argv) {
     for(int i = 0; i < input_dimensionality; i++) { //fill out attributes list
         temp.index = i;
         temp.gain = 0;
+        temp.threshold = 0.5;
+        temp.continuous = false;
         Root.attributes.push_back(temp);
     }
 
     //make tree
-    ID3(&Root);
+    if(sorted) {
+        if(!sorted_columns.build(*pset)) {
+            cerr << argv[0] << " error:  cannot sort the training patterns." << endl;
+            return (-1);
+        }
+        ID3_sorted(&Root, sorted_columns, limits);
+    } else if(binned) {
+        if(!binned_columns.build(*pset)) {
+            cerr << argv[0] << " error:  cannot bin the training patterns." << endl;
+            return (-1);
+        }
+        vector<int> root_hist(binned_columns.histogram_size());
+        binned_columns.fill_histogram(Root.example_indexes, num_training, &root_hist[0]);
+        ID3_histogram(&Root, binned_columns, Root.example_indexes, root_hist, limits);
+    } else if(num_threads > 1)
+        ID3_parallel(&Root, num_threads);
+    else
+        ID3(&Root);
     //print tree
     printDT(&Root, 0);
 
+    //flatten the tree into one array for classifying, and save it if there's a model file
+    FlatTree flat_tree;
+    flat_tree.compile(&Root);
+    if(has_model_file && !flat_tree.save(trim(model_file_name).c_str())) {
+        cerr << argv[0] << " error:  cannot write the model file." << endl;
+        return (-1);
+    }
+
     //classify testing examples
+    return score_patterns(argv[0], flat_tree, input_dimensionality, num_testing, testing_file_name, output_file_name);
+}
+
+//classifies the testing patterns with the flattened tree and writes the results to the output
+//file, the same way whether the tree was just trained or loaded from a model file
+int score_patterns(const char* program, const FlatTree& flat_tree, int input_dimensionality, int num_testing, string testing_file_name, string output_file_name) {
+    PatternSet* testingpset;
+    ifstream input_file_str;
+
     // Make pattern set ...
     testingpset = new PatternSet(num_testing, input_dimensionality, 1);
 
     // Open the pattern set file ...
     input_file_str.open(trim(testing_file_name).c_str());
     if (!input_file_str.is_open()) {
-        cerr << argv[0] << " error:  cannot open specified pattern file." << endl;
+        cerr << program << " error:  cannot open specified pattern file." << endl;
         return (-1);
     }
 
@@ -137,17 +236,30 @@ int main(int argc, char** argv) {
     if (input_file_str.is_open())
         input_file_str.close();
 
+    //copy the testing patterns into rows so they can all be pushed through the flattened tree
+    //together. Gives the same labels as classify_pattern
+    int pattern_size = input_dimensionality+1;
+    vector<double> rows((size_t) num_testing * pattern_size);
+    gsl_vector* curr = gsl_vector_alloc(pattern_size);
+    for(int i = 0; i < num_testing; i++) {
+        testingpset->full_pattern(i, curr);
+        for(int j = 0; j < pattern_size; j++)
+            rows[(size_t) i * pattern_size + j] = gsl_vector_get(curr, j);
+    }
+    vector<int> labels(num_testing);
+    if(num_testing > 0)
+        flat_tree.classify_batch(&rows[0], num_testing, pattern_size, &labels[0]);
+
     //classify values and output results to output_file
     double errors = 0;
-    gsl_vector* curr = gsl_vector_alloc(input_dimensionality+1);
     ofstream output_file_str(trim(output_file_name).c_str());
     for(int i = 0; i < num_testing; i++) {
         testingpset->full_pattern(i, curr);
         for(int j = 0; j < input_dimensionality; j++) {
             output_file_str << gsl_vector_get(curr, j) << " ";
         }
-        output_file_str << classify_pattern(&Root, curr) << " " << gsl_vector_get(curr, input_dimensionality) << " "; //This line calls the function to travel down the tree to the leaf node that classifies the pattern
-        if(classify_pattern(&Root, curr) == gsl_vector_get(curr, input_dimensionality))
+        output_file_str << labels[i] << " " << gsl_vector_get(curr, input_dimensionality) << " "; //the label the tree gave the pattern
+        if(labels[i] == gsl_vector_get(curr, input_dimensionality))
             output_file_str << 0 << endl;
         else {
             output_file_str << 1 << endl;
@@ -167,10 +279,10 @@ int classify_pattern(DTreeNode* root, gsl_vector* pattern) {
     else if(root->label == 0)
         return 0;
     else {
-        if(gsl_vector_get(pattern, root->decision.index)) //pick next node based on decision
-            return classify_pattern(root->childP, pattern);
-        else
-            return classify_pattern(root->childN, pattern);
+        DTreeNode* next = (gsl_vector_get(pattern, root->decision.index) >= root->decision.threshold) ? root->childP : root->childN; //pick next node based on decision
+        if(next == NULL) //no training example went that way, so go with the majority here
+            return (2*root->num_positive >= root->num_examples);
+        return classify_pattern(next, pattern);
     }
 }
 
@@ -190,8 +302,120 @@ double entropy(double numP, double numN) {
     return (0 - (numP/(numP+numN) * slog(numP/(numP+numN))) - (numN/(numP+numN) * slog(numN/(numP+numN))));
 }
 
+//the parallel builder only splits the scoring of a node's attributes across threads when
+//there are at least this many column words to count, below that the tasks cost more than they save
+const long parallel_gain_words = 1 << 14;
+
+//works out the gain of one attribute from the number of examples at a node that have it (ca)
+//and the number of those with a positive label (cap)
+void set_gain(DTreeNode* node, double ca, double cap, attribute& attr) {
+    double can = ca - cap; //count attributes negative
+    double cnap = node->num_positive - cap; //count non attributes positive
+    double cnan = node->num_examples - ca - cnap; //count non attributes negative
+    attr.num_attribute = ca;
+    attr.gain = entropy(cap+cnap, can+cnan);
+    attr.gain -= (cap+can)/node->num_examples*entropy(cap, can);
+    attr.gain -= (cnap+cnan)/node->num_examples*entropy(cnap, cnan);
+}
+
+//works out the gain of one attribute from the masks of the examples at a node and of those
+//with a positive label
+void score_attribute(DTreeNode* node, const uint64_t* mask, const uint64_t* positive_mask, attribute& attr) {
+    const BitColumns* columns = node->columns;
+    const uint64_t* column = columns->column(attr.index);
+    set_gain(node, columns->count_mask(mask, column), columns->count_mask(positive_mask, column), attr);
+}
+
+//a range of the attributes at one node, scored as a single task by the parallel builder
+struct GainTask {
+    DTreeNode* node;
+    const uint64_t* mask;
+    const uint64_t* positive_mask;
+    attribute** attributes;
+    int begin;
+    int end;
+};
+
+void score_attributes_task(void* arg, int worker) {
+    GainTask* task = (GainTask*) arg;
+    for(int a = task->begin; a < task->end; a++)
+        score_attribute(task->node, task->mask, task->positive_mask, *task->attributes[a]);
+}
+
+//does the same as calc_gains below using the packed columns. The examples at the node become
+//a bit mask, so each count is a popcount of that mask ANDed with an attribute column instead
+//of a loop over copies of every pattern. Given a pool, a big enough node has its attributes
+//split between the workers
+void calc_gains_packed(DTreeNode* node, TaskPool* pool, int worker) {
+    const BitColumns* columns = node->columns;
+    int n_words = columns->words_per_column();
+    //a node with fewer examples than a mask has words tests its examples one by one, rather
+    //than building and counting masks as wide as the whole training set
+    if(node->num_examples < n_words) {
+        node->num_positive = 0;
+        for(int e = 0; e < node->num_examples; e++)
+            if(columns->has_label(node->example_indexes[e]))
+                node->num_positive++;
+        for(list<attribute>::iterator it = node->attributes.begin(); it != node->attributes.end(); it++) {
+            double ca = 0; //count attributes
+            double cap = 0; //count attributes positive
+            for(int e = 0; e < node->num_examples; e++) {
+                int i = node->example_indexes[e];
+                if(columns->has_attribute(it->index, i)) {
+                    ca++;
+                    if(columns->has_label(i))
+                        cap++;
+                }
+            }
+            set_gain(node, ca, cap, *it);
+        }
+        return;
+    }
+    vector<uint64_t> mask(n_words); //examples at this node
+    vector<uint64_t> positive_mask(n_words); //examples at this node with a positive label
+    columns->fill_mask(node->example_indexes, node->num_examples, &mask[0]);
+    for(int w = 0; w < n_words; w++)
+        positive_mask[w] = mask[w] & columns->labels()[w];
+    node->num_positive = columns->count_mask(&mask[0], columns->labels());
+    int n_attributes = node->attributes.size();
+    int n_tasks = 1;
+    if(pool && (long) n_words * n_attributes >= parallel_gain_words)
+        n_tasks = min(pool->number_of_workers(), n_attributes);
+    if(n_tasks <= 1) {
+        list<attribute>::iterator it = node->attributes.begin();
+        while(it != node->attributes.end()) {
+            score_attribute(node, &mask[0], &positive_mask[0], *it);
+            it++;
+        }
+        return;
+    }
+    //hand out even ranges of the attributes, keeping the first for this thread
+    vector<attribute*> attributes;
+    for(list<attribute>::iterator it = node->attributes.begin(); it != node->attributes.end(); it++)
+        attributes.push_back(&*it);
+    vector<GainTask> tasks(n_tasks);
+    TaskGroup group;
+    for(int t = 0; t < n_tasks; t++) {
+        tasks[t].node = node;
+        tasks[t].mask = &mask[0];
+        tasks[t].positive_mask = &positive_mask[0];
+        tasks[t].attributes = &attributes[0];
+        tasks[t].begin = (n_attributes * t) / n_tasks;
+        tasks[t].end = (n_attributes * (t + 1)) / n_tasks;
+        if(t > 0)
+            pool->submit(worker, score_attributes_task, &tasks[t], &group);
+    }
+    score_attributes_task(&tasks[0], worker);
+    pool->wait(worker, &group);
+}
+
 //populates all the gain values in my attributes list for the vectors indicated by example_indexes
-void calc_gains(DTreeNode* node) {
+//pool and worker are only used with packed columns, by the parallel builder
+void calc_gains(DTreeNode* node, TaskPool* pool = NULL, int worker = 0) {
+    if(node->columns) { //the attributes are packed, count them a word at a time
+        calc_gains_packed(node, pool, worker);
+        return;
+    }
     list<attribute>::iterator it = node->attributes.begin(); //for each attribute that is still under consideration
     while(it != node->attributes.end()) {
         //calculate entropy of positive examples
@@ -237,50 +461,74 @@ list<attribute>::iterator best_attribute(DTreeNode* node) {
     return best;
 }
 
-//print a visual representation of the decision tree to stdout
+//a step of printDT. side 0 prints the node itself, and 1 or 2 print the line leading to its
+//negative or positive child and then the child
+struct PrintStep {
+    DTreeNode* node;
+    int depth;
+    int side;
+};
+
+//print a visual representation of the decision tree to stdout. Walks the tree with a stack of
+//its own rather than recursing, since continuous trees can be as deep as they have examples
 void printDT(DTreeNode* root, int depth) {
-    if(root->label == 1) { //this is a leaf node for TRUE
-        for(int i = 0; i < depth; i++)
-            cout << "  ";
-        cout << "  TRUE" << endl;
-    } else if(root->label == 0) { //this is a leaf node for FALSE
-        for(int i = 0; i < depth; i++)
+    vector<PrintStep> steps;
+    PrintStep step = { root, depth, 0 };
+    steps.push_back(step);
+    while(!steps.empty()) {
+        step = steps.back();
+        steps.pop_back();
+        DTreeNode* node = step.node;
+        if(step.side == 0 && node->label < 0) { //this is a non leaf node. We must go deeper, negative side first
+            PrintStep below = { node, step.depth, 2 };
+            if(node->childP)
+                steps.push_back(below);
+            below.side = 1;
+            if(node->childN)
+                steps.push_back(below);
+            continue;
+        }
+        for(int i = 0; i < step.depth; i++)
             cout << "  ";
-        cout << "  FALSE" << endl;
-    } else { //this is a non leaf node. We must go deeper...
-        if(root->childN) {
-            for(int i = 0; i < depth; i++)
-                cout << "  ";
-            cout << root->decision.index + 1;
-            cout << " false then\n";
-            printDT(root->childN, depth+1);
+        if(step.side == 0) //this is a leaf node, TRUE or FALSE
+            cout << (node->label == 1 ? "  TRUE" : "  FALSE") << endl;
+        else {
+            cout << node->decision.index + 1;
+            if(node->decision.continuous)
+                cout << (step.side == 1 ? " < " : " >= ") << node->decision.threshold << " then\n";
+            else
+                cout << (step.side == 1 ? " false then\n" : " true then\n");
+            PrintStep child = { step.side == 1 ? node->childN : node->childP, step.depth + 1, 0 };
+            steps.push_back(child);
         }
-        if(root->childP) {
-            for(int i = 0; i < depth; i++)
-                cout << "  ";
-            cout << root->decision.index + 1;
-            cout << " true then\n";
-            printDT(root->childP, depth+1);
-        }    }
+    }
 }
 
-//not a super easy to use stand alone version of ID3. But if you set up the root node
-//correctly it recusively fills out the children to form a Decision learning tree
-void ID3(DTreeNode* node) {
+//works out the decision at a single node and attaches its children, without building their
+//subtrees. This is the body of ID3, pulled out so that the parallel builder can hand the
+//children to other threads. Returns false if the node is a leaf. trace prints the progress
+//log that ID3 always has
+bool split_node(DTreeNode* node, bool trace, TaskPool* pool = NULL, int worker = 0) {
+    node->childP = NULL;
+    node->childN = NULL;
     //calculate the gain and other assorted math-y values based on examples and attributes still under consideration at this node
-    calc_gains(node);
+    calc_gains(node, pool, worker);
     //break conditions
     if(node->num_positive == node->num_examples) { //all of the elements under consideration have a positive output value
         node->label = 1;
-        cout << "1\n";
-        return;
+        if(trace)
+            cout << "1\n";
+        return false;
     } else if(node->num_positive == 0) { //all of the elements have negative output
         node->label = 0; 
-        cout << "0\n";
-        return;
-    } else if(node->attributes.size() == 0) { //there are still elements, but no attributes this is an edge case that shouldnt occur in our simple implementaion (unless I'm stupid)
-        cout << "no attributes" << endl;
-        //I dont think it gets here
+        if(trace)
+            cout << "0\n";
+        return false;
+    } else if(node->attributes.size() == 0) { //there are still elements, but no attributes. Happens when identical patterns have different labels, so go with the majority
+        if(trace)
+            cout << "no attributes" << endl;
+        node->label = (2*node->num_positive >= node->num_examples);
+        return false;
     } else { //currently have multiple elements with non zero entropy to classify. Recurse
         node->label = -1;
     }
@@ -289,12 +537,14 @@ void ID3(DTreeNode* node) {
     node->decision = *best_attribute(node);
     //decision is 0 based. For the print I offset it by 1 to make it match the log we were given in example
     //this prints the current best attribute to decide on
-    cout << "decision:" << node->decision.index << endl;
-    //this prints all the elements still under consideration at this node
-    for(int i = 0; i < node->num_examples; i++) {
-        cout << node->example_indexes[i] << " ";
+    if(trace) {
+        cout << "decision:" << node->decision.index << endl;
+        //this prints all the elements still under consideration at this node
+        for(int i = 0; i < node->num_examples; i++) {
+            cout << node->example_indexes[i] << " ";
+        }
+        cout << endl;
     }
-    cout << endl;
 
     //split* the set based on the attribute
     //I'm using arrays of indexes to indicate which elements are under consideration. Simple, maybe too simple. works fine though
@@ -302,14 +552,21 @@ void ID3(DTreeNode* node) {
     int * negative = new int[node->num_examples - node->decision.num_attribute];
     gsl_vector* curr = gsl_vector_alloc(node->pset->pattern_size());
     for(int i = 0, j = 0; j+i < node->num_examples;) {
-        node->pset->full_pattern(node->example_indexes[i+j], curr);
-        int index;
-        if(gsl_vector_get(curr, node->decision.index)) {
-            positive[i++] = node->example_indexes[i+j];
+        int example = node->example_indexes[i+j];
+        bool has_attribute;
+        if(node->columns) //read the bit straight from the packed column
+            has_attribute = node->columns->has_attribute(node->decision.index, example);
+        else {
+            node->pset->full_pattern(example, curr);
+            has_attribute = gsl_vector_get(curr, node->decision.index) >= node->decision.threshold; //same test as calc_gains counted with
+        }
+        if(has_attribute) {
+            positive[i++] = example;
         } else {
-            negative[j++] = node->example_indexes[i+j];
+            negative[j++] = example;
         }
     }
+    gsl_vector_free(curr);
 
     //construct child nodes
     //Since all the attributes have binary value I hard coded a case for positive and negative values. 
@@ -318,9 +575,9 @@ void ID3(DTreeNode* node) {
         node->childP->example_indexes = positive;
         node->childP->num_examples = node->decision.num_attribute;
         node->childP->pset = node->pset;
+        node->childP->columns = node->columns;
         node->childP->attributes = node->attributes;
         node->childP->attributes.erase(best_attribute(node->childP));
-        ID3(node->childP);
     } else { //This is unimportant since our examples are all binary and I hard coded an iteration for both 1 and 0. If it was the case that you could have a dynamic range of values for the attribute then I would need to handle cases where none of the patterns have the value vi for the attribute, in which case it would guess from the most likely value based on the output from the examples it does have. 
         /* cout << "TODO"; */
         /* cout << node->decision.index + 1 << " " << node->decision.gain << endl; */
@@ -332,11 +589,318 @@ void ID3(DTreeNode* node) {
         node->childN->example_indexes = negative;
         node->childN->num_examples = node->num_examples - node->decision.num_attribute;
         node->childN->pset = node->pset;
+        node->childN->columns = node->columns;
         node->childN->attributes = node->attributes;
         node->childN->attributes.erase(best_attribute(node->childN));
-        ID3(node->childN);
     } else {
         /* cout << "TODO"; */
         /* cout << node->decision.index + 1 << " " << node->decision.gain << endl; */
     }
+    return true;
+}
+
+//not a super easy to use stand alone version of ID3. But if you set up the root node
+//correctly it recusively fills out the children to form a Decision learning tree
+void ID3(DTreeNode* node) {
+    if(split_node(node, true)) {
+        if(node->childP)
+            ID3(node->childP);
+        if(node->childN)
+            ID3(node->childN);
+    }
+}
+
+//ID3 without the progress log, for subtrees too small to be worth handing out as tasks
+void ID3_quiet(DTreeNode* node) {
+    if(split_node(node, false)) {
+        if(node->childP)
+            ID3_quiet(node->childP);
+        if(node->childN)
+            ID3_quiet(node->childN);
+    }
+}
+
+//subtrees with fewer examples than this are built by one thread from start to finish
+const int parallel_subtree_examples = 2048;
+
+//a subtree waiting to be built by the parallel builder
+struct SubtreeTask {
+    DTreeNode* node;
+    TaskPool* pool;
+    TaskGroup* group;
+};
+
+//splits one node and queues up its children as new tasks in the same group, so the group is
+//done once the whole tree is
+void build_subtree_task(void* arg, int worker) {
+    SubtreeTask* task = (SubtreeTask*) arg;
+    DTreeNode* node = task->node;
+    if(node->num_examples < parallel_subtree_examples)
+        ID3_quiet(node);
+    else if(split_node(node, false, task->pool, worker)) {
+        DTreeNode* children[2] = { node->childP, node->childN };
+        for(int c = 0; c < 2; c++) {
+            if(children[c]) {
+                SubtreeTask* child_task = new SubtreeTask;
+                child_task->node = children[c];
+                child_task->pool = task->pool;
+                child_task->group = task->group;
+                task->pool->submit(worker, build_subtree_task, child_task, task->group);
+            }
+        }
+    }
+    delete task;
+}
+
+//builds the same tree as ID3 with num_threads threads. Independent subtrees are tasks on a
+//work stealing pool, and large nodes also split the scoring of their attributes between the
+//workers. Nothing is printed while building since the order would be all over the place
+void ID3_parallel(DTreeNode* root, int num_threads) {
+    TaskPool pool(num_threads);
+    TaskGroup group;
+    SubtreeTask* task = new SubtreeTask;
+    task->node = root;
+    task->pool = &pool;
+    task->group = &group;
+    pool.submit(0, build_subtree_task, task, &group);
+    pool.wait(0, &group);
+}
+
+//the gain of splitting n examples, num_positive of them positive, so that cna of them (cnap of
+//those positive) fall below the threshold and the rest have the attribute
+double split_gain(double node_entropy, double n, double num_positive, double cna, double cnap) {
+    double cap = num_positive - cnap; //count attributes positive
+    double can = (n - cna) - cap; //count attributes negative
+    double cnan = cna - cnap; //count non attributes negative
+    double gain = node_entropy;
+    gain -= (cap+can)/n*entropy(cap, can);
+    gain -= cna/n*entropy(cnap, cnan);
+    return gain;
+}
+
+//finds the best place to split the examples in positions begin to end of the sorted columns
+//on attribute a. Walking the examples in order of the attribute value, the counts on each
+//side of a cut change by one example at a time, so every cut between two different values is
+//scored in a single pass with no sorting. The attribute side is at or above the threshold,
+//which sits halfway between the values on either side of the cut. Cuts leaving fewer than
+//min_leaf examples on a side are passed over. Returns false if no cut is left, as when the
+//examples all have the same value
+bool best_threshold(const SortedColumns& columns, int a, int begin, int end, int num_positive, int min_leaf, attribute& attr) {
+    const int* order = columns.order(a);
+    double n = end - begin;
+    double cnap = 0; //count non attributes positive, below the cut
+    double cna = 0; //count non attributes
+    double node_entropy = entropy(num_positive, n - num_positive);
+    bool found = false;
+    attr.index = a;
+    attr.continuous = true;
+    for(int k = begin; k < end - 1; k++) {
+        int i = order[k];
+        cna++;
+        cnap += columns.label(i);
+        double below = columns.value(a, i);
+        double above = columns.value(a, order[k+1]);
+        if(below == above) //can't cut between equal values
+            continue;
+        if(cna < min_leaf || n - cna < min_leaf)
+            continue;
+        double gain = split_gain(node_entropy, n, num_positive, cna, cnap);
+        if(!found || gain > attr.gain) {
+            attr.gain = gain;
+            attr.num_attribute = n - cna;
+            attr.threshold = below + (above - below)/2;
+            if(attr.threshold <= below) //the values are too close to have anything in between
+                attr.threshold = above;
+            found = true;
+        }
+    }
+    return found;
+}
+
+//a node waiting to be built by ID3_sorted or ID3_histogram, with its examples at positions
+//begin to end. hist is only used by ID3_histogram
+struct PendingNode {
+    DTreeNode* node;
+    int begin;
+    int end;
+    int depth;
+    vector<int> hist;
+};
+
+//makes a new child of node for one of the builders below, queued up on the stack to be built
+//with the examples at positions begin to end. Returns the queued node
+PendingNode& push_child(vector<PendingNode>& stack, DTreeNode*& child, DTreeNode* node, int begin, int end, int depth) {
+    child = new DTreeNode;
+    child->pset = node->pset;
+    child->columns = NULL;
+    stack.push_back(PendingNode());
+    PendingNode& pending = stack.back();
+    pending.node = child;
+    pending.begin = begin;
+    pending.end = end;
+    pending.depth = depth;
+    return pending;
+}
+
+//ID3 for continuous attributes. A node's examples are positions begin to end of the sorted
+//columns. Each node tries a threshold split on every attribute, and attributes can be split
+//again further down since a different threshold may still help. The children get the two
+//halves of the node's positions, partitioned so they stay sorted. Nothing bounds the depth
+//but the limits, so the nodes waiting to be built are kept on a stack rather than recursing
+void ID3_sorted(DTreeNode* root, SortedColumns& columns, const TreeLimits& limits) {
+    vector<PendingNode> stack(1);
+    stack[0].node = root;
+    stack[0].begin = 0;
+    stack[0].end = columns.number_of_examples();
+    stack[0].depth = 0;
+    while(!stack.empty()) {
+        DTreeNode* node = stack.back().node;
+        int begin = stack.back().begin;
+        int end = stack.back().end;
+        int depth = stack.back().depth;
+        stack.pop_back();
+        node->childP = NULL;
+        node->childN = NULL;
+        node->example_indexes = NULL;
+        node->num_examples = end - begin;
+        node->num_positive = columns.count_positive(begin, end);
+        if(node->num_positive == node->num_examples) { //all positive
+            node->label = 1;
+            continue;
+        } else if(node->num_positive == 0) { //all negative
+            node->label = 0;
+            continue;
+        }
+        //pick the attribute and threshold with the highest gain, earliest attribute on ties like best_attribute.
+        //none is tried once the node is as deep as the limit allows
+        bool found = false;
+        attribute candidate;
+        int num_attributes = (limits.max_depth == 0 || depth < limits.max_depth) ? columns.number_of_attributes() : 0;
+        for(int a = 0; a < num_attributes; a++) {
+            if(best_threshold(columns, a, begin, end, node->num_positive, limits.min_leaf, candidate) &&
+                    (!found || candidate.gain > node->decision.gain)) {
+                node->decision = candidate;
+                found = true;
+            }
+        }
+        if(!found) { //identical patterns with different labels, or a limit reached, go with the majority
+            node->label = (2*node->num_positive >= node->num_examples);
+            continue;
+        }
+        node->label = -1;
+        int split = columns.partition(begin, end, node->decision.index, node->decision.threshold);
+        //the negative child goes on top so it's built first, as it was when this recursed
+        push_child(stack, node->childP, node, split, end, depth + 1);
+        push_child(stack, node->childN, node, begin, split, depth + 1);
+    }
+}
+
+//finds the best threshold for attribute a among the edges between its bins, given the node's
+//histogram. Works like best_threshold but steps a bin at a time, so the cost depends on the
+//number of bins instead of the number of examples. Sets bin to the first bin on the attribute
+//side. Cuts leaving fewer than min_leaf examples on a side are passed over. Returns false if no
+//cut is left, as when the node's examples all fall in one bin
+bool best_bin_threshold(const BinnedColumns& columns, const int* hist, int a, int num_examples, int num_positive, int min_leaf, attribute& attr, int& bin) {
+    int n_bins = columns.number_of_bins(a);
+    const int* counts = columns.bin_counts(hist, a);
+    const int* positives = counts + n_bins;
+    double n = num_examples;
+    double node_entropy = entropy(num_positive, n - num_positive);
+    double cnap = 0; //count non attributes positive, in the bins below the cut
+    double cna = 0; //count non attributes
+    bool found = false;
+    attr.index = a;
+    attr.continuous = true;
+    for(int b = 1; b < n_bins; b++) {
+        cna += counts[b-1];
+        cnap += positives[b-1];
+        if(cna < min_leaf || n - cna < min_leaf) //everything (or too little) is on one side of this cut
+            continue;
+        double gain = split_gain(node_entropy, n, num_positive, cna, cnap);
+        if(!found || gain > attr.gain) {
+            attr.gain = gain;
+            attr.num_attribute = n - cna;
+            attr.threshold = columns.cut(a, b);
+            bin = b;
+            found = true;
+        }
+    }
+    return found;
+}
+
+//ID3 for continuous attributes using binned columns. A node's examples are positions begin to
+//end of examples, and its histogram is on the stack with it, free to be overwritten. After a
+//split only the smaller child's histogram is counted from its examples. The larger child's is
+//the parent's less the smaller one's, worked out in place. root_hist is the histogram of all
+//the examples, and is used up
+void ID3_histogram(DTreeNode* root, const BinnedColumns& columns, int* examples, vector<int>& root_hist, const TreeLimits& limits) {
+    vector<PendingNode> stack(1);
+    stack[0].node = root;
+    stack[0].begin = 0;
+    stack[0].end = columns.number_of_examples();
+    stack[0].depth = 0;
+    stack[0].hist.swap(root_hist);
+    vector<int> hist;
+    while(!stack.empty()) {
+        DTreeNode* node = stack.back().node;
+        int begin = stack.back().begin;
+        int end = stack.back().end;
+        int depth = stack.back().depth;
+        hist.swap(stack.back().hist);
+        stack.pop_back();
+        node->childP = NULL;
+        node->childN = NULL;
+        node->example_indexes = NULL;
+        node->num_examples = end - begin;
+        node->num_positive = 0;
+        const int* counts = columns.bin_counts(&hist[0], 0);
+        for(int b = 0; b < columns.number_of_bins(0); b++)
+            node->num_positive += counts[columns.number_of_bins(0) + b];
+        if(node->num_positive == node->num_examples) { //all positive
+            node->label = 1;
+            continue;
+        } else if(node->num_positive == 0) { //all negative
+            node->label = 0;
+            continue;
+        }
+        //pick the attribute and threshold with the highest gain, earliest on ties like ID3_sorted
+        bool found = false;
+        int split_bin = 0;
+        attribute candidate;
+        int candidate_bin;
+        int num_attributes = (limits.max_depth == 0 || depth < limits.max_depth) ? columns.number_of_attributes() : 0;
+        for(int a = 0; a < num_attributes; a++) {
+            if(best_bin_threshold(columns, &hist[0], a, node->num_examples, node->num_positive, limits.min_leaf, candidate, candidate_bin) &&
+                    (!found || candidate.gain > node->decision.gain)) {
+                node->decision = candidate;
+                split_bin = candidate_bin;
+                found = true;
+            }
+        }
+        if(!found) { //every attribute has all the examples in one bin, or a limit reached, go with the majority
+            node->label = (2*node->num_positive >= node->num_examples);
+            continue;
+        }
+        node->label = -1;
+        //move the examples below the threshold to the front
+        int split = begin;
+        for(int k = begin; k < end; k++) {
+            if(columns.code(node->decision.index, examples[k]) < split_bin) {
+                int temp = examples[k];
+                examples[k] = examples[split];
+                examples[split++] = temp;
+            }
+        }
+        //count the smaller child and subtract it from the parent for the larger
+        bool below_smaller = (split - begin <= end - split);
+        vector<int> smaller_hist(columns.histogram_size());
+        if(below_smaller)
+            columns.fill_histogram(examples + begin, split - begin, &smaller_hist[0]);
+        else
+            columns.fill_histogram(examples + split, end - split, &smaller_hist[0]);
+        columns.subtract_histogram(&hist[0], &smaller_hist[0]);
+        //the negative child goes on top so it's built first, as it was when this recursed
+        push_child(stack, node->childP, node, split, end, depth + 1).hist.swap(below_smaller ? hist : smaller_hist);
+        push_child(stack, node->childN, node, begin, split, depth + 1).hist.swap(below_smaller ? smaller_hist : hist);
+    }
 }
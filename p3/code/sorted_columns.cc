@@ -0,0 +1,130 @@
+//
+// sorted_columns.cc :  Implementation file for the input attributes of a
+//                      "pattern set" object kept in sorted order.
+//
+
+
+#include <vector>
+#include <algorithm>
+
+#include <gsl/gsl_vector.h>
+
+#include "patterns.h"
+#include "sorted_columns.h"
+
+
+// ValueOrder -- Orders example indices by their value in a single column,
+//               breaking ties by index so that the order is repeatable.
+struct ValueOrder {
+    const double* column;
+
+    ValueOrder(const double* col) : column(col) { }
+
+    bool operator()(int i, int j) const {
+        return ((column[i] < column[j]) ||
+                ((column[i] == column[j]) && (i < j)));
+    }
+};
+
+
+//
+// SortedColumns Class  --  Member function implementations
+//
+
+// constructor
+
+SortedColumns::SortedColumns() {
+    n_examples = 0;
+    n_attributes = 0;
+}
+
+
+// build -- Fill the columns from the given pattern set, sorting each one,
+//          replacing any previous contents.  The label is the last target
+//          value, thresholded at 0.5.  Return false on error.
+
+bool SortedColumns::build(const PatternSet& pset) {
+    int num_examples = pset.number_of_patterns();
+    int num_attributes = pset.number_of_inputs();
+    int size = pset.pattern_size();
+
+    if ((num_examples <= 0) || (num_attributes <= 0) ||
+            (pset.number_of_targets() <= 0))
+        return (false);
+    gsl_vector* curr = gsl_vector_alloc(size);
+    if (curr == NULL)
+        return (false);
+    n_examples = num_examples;
+    n_attributes = num_attributes;
+    values.resize((size_t) n_attributes * n_examples);
+    orders.resize((size_t) n_attributes * n_examples);
+    labels.resize(n_examples);
+    goes_right.assign(n_examples, 0);
+    scratch.resize(n_examples);
+    // transpose the patterns into columns ...
+    for (int i = 0; i < n_examples; i++) {
+        pset.full_pattern(i, curr);
+        for (int a = 0; a < n_attributes; a++)
+            values[(size_t) a * n_examples + i] = gsl_vector_get(curr, a);
+        labels[i] = (gsl_vector_get(curr, size - 1) >= 0.5);
+    }
+    gsl_vector_free(curr);
+    // this is the only sort; splits keep the order from here on ...
+    for (int a = 0; a < n_attributes; a++) {
+        int* col_order = &orders[0] + (size_t) a * n_examples;
+        for (int i = 0; i < n_examples; i++)
+            col_order[i] = i;
+        sort(col_order, col_order + n_examples,
+                ValueOrder(&values[0] + (size_t) a * n_examples));
+    }
+    return (true);
+}
+
+
+// count_positive -- Return the number of examples with a positive label in
+//                   the given range of positions.
+
+int SortedColumns::count_positive(int begin, int end) const {
+    const int* col_order = order(0);
+    int count = 0;
+
+    for (int k = begin; k < end; k++)
+        count += labels[col_order[k]];
+    return (count);
+}
+
+
+// partition -- Split the given range of positions in every sorted array,
+//              moving the examples whose "a"th attribute is below
+//              "threshold" ahead of the rest, each side staying in sorted
+//              order.  Return the position of the first example at or above
+//              the threshold.
+
+int SortedColumns::partition(int begin, int end, int a, double threshold) {
+    const int* split_order = order(a);
+    int split = begin;
+
+    // note the side of each example once, by the splitting attribute ...
+    for (int k = begin; k < end; k++) {
+        int i = split_order[k];
+        goes_right[i] = (value(a, i) >= threshold);
+        split += !goes_right[i];
+    }
+    // ... then partition every column by those sides, the right hand side
+    // going through this node's part of the scratch array
+    for (int b = 0; b < n_attributes; b++) {
+        int* col_order = &orders[0] + (size_t) b * n_examples;
+        int left = begin;
+        int right = begin;
+        for (int k = begin; k < end; k++) {
+            int i = col_order[k];
+            if (goes_right[i])
+                scratch[right++] = i;
+            else
+                col_order[left++] = i;
+        }
+        for (int k = begin; left < end; k++)
+            col_order[left++] = scratch[k];
+    }
+    return (split);
+}
@@ -0,0 +1,93 @@
+//
+// sorted_columns.h :  Specification file for the input attributes of a
+//                     "pattern set" object kept in sorted order, for
+//                     finding threshold splits of continuous attributes in
+//                     decision tree training.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef SORTED_COLUMNS_INCLUDED
+#define SORTED_COLUMNS_INCLUDED 1
+
+
+#include <vector>
+
+#include "patterns.h"
+
+
+using namespace std;
+
+
+//
+// SortedColumns Class  --  The input attributes of a set of training
+//                          examples, column by column, along with an array
+//                          of example indices for each attribute sorted by
+//                          that attribute's value.  Every node of a tree
+//                          under construction owns the same range of
+//                          positions in all of the sorted arrays, holding
+//                          just its own examples, still in sorted order.
+//                          Splitting a node partitions its range of each
+//                          array stably, so its children inherit sorted
+//                          ranges and nothing is sorted again after the
+//                          first time.  Nodes with disjoint ranges may be
+//                          split at the same time.
+//
+
+class SortedColumns {
+
+    private:
+
+        int n_examples;           // number of examples
+        int n_attributes;         // number of input attributes
+        vector<double> values;    // the attribute values, one column after
+                                  // another
+        vector<int> orders;       // the example indices of each column,
+                                  // sorted within each node's range
+        vector<char> labels;      // the label of each example
+        vector<char> goes_right;  // side of each example in the current split
+        vector<int> scratch;      // room for the right side of a partition
+
+    public:
+
+        SortedColumns();
+
+        // build -- Fill the columns from the given pattern set, sorting each
+        //          one, replacing any previous contents.  The label is the
+        //          last target value, thresholded at 0.5.  Return false on
+        //          error.
+        bool build(const PatternSet& pset);
+
+        // number_of_examples -- Return the number of examples stored.
+        inline int number_of_examples() const { return n_examples; }
+
+        // number_of_attributes -- Return the number of input attributes.
+        inline int number_of_attributes() const { return n_attributes; }
+
+        // order -- Return the example indices sorted by the "a"th attribute.
+        inline const int* order(int a) const
+            { return (&orders[0] + (size_t) a * n_examples); }
+
+        // value -- Return the "a"th attribute of the "i"th example.
+        inline double value(int a, int i) const
+            { return (values[(size_t) a * n_examples + i]); }
+
+        // label -- Return the label of the "i"th example.
+        inline bool label(int i) const { return (labels[i] != 0); }
+
+        // count_positive -- Return the number of examples with a positive
+        //                   label in the given range of positions.
+        int count_positive(int begin, int end) const;
+
+        // partition -- Split the given range of positions in every sorted
+        //              array, moving the examples whose "a"th attribute is
+        //              below "threshold" ahead of the rest, each side staying
+        //              in sorted order.  Return the position of the first
+        //              example at or above the threshold.
+        int partition(int begin, int end, int a, double threshold);
+
+};
+
+
+
+#endif  // #ifndef SORTED_COLUMNS_INCLUDED
@@ -0,0 +1,168 @@
+//
+// task_pool.cc :  Implementation file for a pool of worker threads that run
+//                 small tasks, stealing work from one another when idle.
+//
+
+
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+
+#include "task_pool.h"
+
+
+//
+// TaskPool Class  --  Member function implementations
+//
+
+// constructor
+
+TaskPool::TaskPool(int num_workers) {
+    n_workers = (num_workers > 1) ? num_workers : 1;
+    queues.resize(n_workers);
+    queue_locks.resize(n_workers);
+    for (int w = 0; w < n_workers; w++)
+        pthread_mutex_init(&queue_locks[w], NULL);
+    pthread_mutex_init(&state_lock, NULL);
+    pthread_cond_init(&state_changed, NULL);
+    n_queued = 0;
+    stopping = false;
+    // the pool threads are workers one and up ...
+    starts.resize(n_workers);
+    for (int w = 1; w < n_workers; w++) {
+        pthread_t thread;
+        starts[w].pool = this;
+        starts[w].worker = w;
+        // a worker whose thread fails to start just has its tasks stolen ...
+        if (pthread_create(&thread, NULL, worker_loop, &starts[w]) == 0)
+            threads.push_back(thread);
+    }
+}
+
+
+// destructor
+
+TaskPool::~TaskPool() {
+    pthread_mutex_lock(&state_lock);
+    stopping = true;
+    pthread_cond_broadcast(&state_changed);
+    pthread_mutex_unlock(&state_lock);
+    for (size_t t = 0; t < threads.size(); t++)
+        (void) pthread_join(threads[t], NULL);
+    pthread_cond_destroy(&state_changed);
+    pthread_mutex_destroy(&state_lock);
+    for (int w = 0; w < n_workers; w++)
+        pthread_mutex_destroy(&queue_locks[w]);
+}
+
+
+// submit -- Queue a task on the given worker, adding it to "group".
+
+void TaskPool::submit(int worker, TaskFunction function, void* arg,
+        TaskGroup* group) {
+    Task task;
+
+    task.function = function;
+    task.arg = arg;
+    task.group = group;
+    // count the task before it can be taken, so the group never looks done
+    // early ...
+    pthread_mutex_lock(&state_lock);
+    group->pending++;
+    n_queued++;
+    pthread_mutex_unlock(&state_lock);
+    pthread_mutex_lock(&queue_locks[worker]);
+    queues[worker].push_back(task);
+    pthread_mutex_unlock(&queue_locks[worker]);
+    pthread_mutex_lock(&state_lock);
+    pthread_cond_broadcast(&state_changed);
+    pthread_mutex_unlock(&state_lock);
+}
+
+
+// take -- Remove a task for the given worker, from its own queue if it has
+//         any, or else from another's.  Return false if no task was found.
+
+bool TaskPool::take(int worker, Task& task) {
+    bool found = false;
+
+    for (int i = 0; (i < n_workers) && !found; i++) {
+        int victim = (worker + i) % n_workers;
+        pthread_mutex_lock(&queue_locks[victim]);
+        if (!queues[victim].empty()) {
+            // newest of our own, oldest of anybody else's ...
+            if (i == 0) {
+                task = queues[victim].back();
+                queues[victim].pop_back();
+            } else {
+                task = queues[victim].front();
+                queues[victim].pop_front();
+            }
+            found = true;
+        }
+        pthread_mutex_unlock(&queue_locks[victim]);
+    }
+    if (found) {
+        pthread_mutex_lock(&state_lock);
+        n_queued--;
+        pthread_mutex_unlock(&state_lock);
+    }
+    return (found);
+}
+
+
+// run -- Run the given task, then count it as finished.
+
+void TaskPool::run(const Task& task, int worker) {
+    task.function(task.arg, worker);
+    pthread_mutex_lock(&state_lock);
+    if (--task.group->pending == 0)
+        pthread_cond_broadcast(&state_changed);
+    pthread_mutex_unlock(&state_lock);
+}
+
+
+// wait -- Run tasks as the given worker until every task of "group" has
+//         finished.
+
+void TaskPool::wait(int worker, TaskGroup* group) {
+    for (;;) {
+        Task task;
+        if (take(worker, task)) {
+            run(task, worker);
+            continue;
+        }
+        // nothing to run, so sleep until there is, or the group is done ...
+        pthread_mutex_lock(&state_lock);
+        while ((group->pending > 0) && (n_queued == 0))
+            pthread_cond_wait(&state_changed, &state_lock);
+        bool done = (group->pending == 0);
+        pthread_mutex_unlock(&state_lock);
+        if (done)
+            return;
+    }
+}
+
+
+// worker_loop -- Body of each pool thread.
+
+void* TaskPool::worker_loop(void* arg) {
+    WorkerStart* start = (WorkerStart*) arg;
+    TaskPool* pool = start->pool;
+
+    for (;;) {
+        Task task;
+        if (pool->take(start->worker, task)) {
+            pool->run(task, start->worker);
+            continue;
+        }
+        pthread_mutex_lock(&pool->state_lock);
+        while ((pool->n_queued == 0) && !pool->stopping)
+            pthread_cond_wait(&pool->state_changed, &pool->state_lock);
+        bool stop = pool->stopping;
+        pthread_mutex_unlock(&pool->state_lock);
+        if (stop)
+            return (NULL);
+    }
+}
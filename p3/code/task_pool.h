@@ -0,0 +1,119 @@
+//
+// task_pool.h :  Specification file for a pool of worker threads that run
+//                small tasks, stealing work from one another when idle.
+//
+
+
+// Make sure that this header file is loaded only once ...
+#ifndef TASK_POOL_INCLUDED
+#define TASK_POOL_INCLUDED 1
+
+
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+
+
+using namespace std;
+
+
+// TaskFunction -- A task body, called with its argument and the number of
+//                 the worker running it, which is the worker that tasks it
+//                 submits should be given to.
+typedef void (*TaskFunction)(void* arg, int worker);
+
+
+// TaskGroup -- A count of the tasks submitted with this group that have
+//              not yet finished, so that they can be waited for together.
+//              Tasks may add more tasks to their own group.
+struct TaskGroup {
+    int pending;              // tasks submitted but not yet finished
+
+    TaskGroup() : pending(0) { }
+};
+
+
+//
+// TaskPool Class  --  A fixed set of workers, each with a queue of tasks of
+//                     its own.  A worker takes its newest task first, so
+//                     that work on a tree goes depth first and stays in
+//                     cache, and when its own queue is empty it steals the
+//                     oldest task of another worker, which tends to be the
+//                     largest piece of work available.  Worker zero is the
+//                     thread that calls "wait"; it runs tasks itself while
+//                     it waits, so a pool whose threads could not be
+//                     started still finishes its work.
+//
+
+class TaskPool {
+
+    private:
+
+        // Task -- A function and argument waiting to be run.
+        struct Task {
+            TaskFunction function;
+            void* arg;
+            TaskGroup* group;
+        };
+
+        // WorkerStart -- What a pool thread needs to find its place.
+        struct WorkerStart {
+            TaskPool* pool;
+            int worker;
+        };
+
+        int n_workers;            // number of workers, counting the caller
+        vector< deque<Task> > queues;   // the tasks of each worker
+        vector<pthread_mutex_t> queue_locks;  // a lock on each queue
+
+        pthread_mutex_t state_lock;   // guards the counts below
+        pthread_cond_t state_changed; // signalled on submit and completion
+        int n_queued;             // tasks in all queues, not yet taken
+        bool stopping;            // true once the pool is being destroyed
+
+        vector<pthread_t> threads;    // the pool threads that started
+        vector<WorkerStart> starts;   // arguments of the pool threads
+
+        // pools are not copyable ...
+        TaskPool(const TaskPool&);
+        TaskPool& operator=(const TaskPool&);
+
+        // take -- Remove a task for the given worker, from its own queue if
+        //         it has any, or else from another's.  Return false if no
+        //         task was found.
+        bool take(int worker, Task& task);
+
+        // run -- Run the given task, then count it as finished.
+        void run(const Task& task, int worker);
+
+        // worker_loop -- Body of each pool thread.
+        static void* worker_loop(void* arg);
+
+    public:
+
+        // Make a pool of "num_workers" workers, starting a thread for each
+        // worker but the first, which is whichever thread waits.
+        TaskPool(int num_workers);
+
+        // Stop and join the pool threads.  Tasks still queued are dropped,
+        // so every group should have been waited for.
+        ~TaskPool();
+
+        // number_of_workers -- Return the number of workers, counting the
+        //                      waiting thread.
+        inline int number_of_workers() const { return n_workers; }
+
+        // submit -- Queue a task on the given worker, adding it to "group".
+        void submit(int worker, TaskFunction function, void* arg,
+                TaskGroup* group);
+
+        // wait -- Run tasks as the given worker until every task of "group"
+        //         has finished.
+        void wait(int worker, TaskGroup* group);
+
+};
+
+
+
+#endif  // #ifndef TASK_POOL_INCLUDED